@@ -0,0 +1,105 @@
+#  benchmark.py
+#  Emulator benchmarks
+
+# Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+# This file is part of Jigo2600 and is made available under
+# the terms of the BSD license (see the COPYING file).
+
+import argparse
+import json
+import sys
+import time
+
+import jigo2600
+from jigo2600 import Atari2600, TIA
+
+# -------------------------------------------------------------------
+# Benchmarks
+# -------------------------------------------------------------------
+
+
+def make_atari(cart_bytes):
+    atari = Atari2600()
+    atari.cartridge = jigo2600.make_cartridge_from_bytes(cart_bytes)
+    return atari
+
+
+def bench_render_modes(cart_bytes, num_frames):
+    "Measure the simulation speed in frames per second for each TIA render mode."
+    results = {}
+    for name, mode in TIA.RenderMode.__members__.items():
+        atari = make_atari(cart_bytes)
+        atari.tia.render_mode = mode
+        start = time.perf_counter()
+        atari.run_frames(num_frames)
+        results[name] = num_frames / (time.perf_counter() - start)
+    return results
+
+
+def bench_option(cart_bytes, num_frames, option):
+    """Measure the simulation speed with and without a speed option, such as
+    `fast_scanline`, `fast_cpu`, `fast_wsync` or `static_cartridge_dispatch`,
+    and count the frames that differ between the two."""
+    results = {}
+    frames = {}
+    for fast in (False, True):
+        atari = make_atari(cart_bytes)
+        setattr(atari, option, fast)
+        frame = atari.get_last_frame()
+        frame_size = frame.width * frame.height * 4
+        screens = bytearray(num_frames * frame_size)
+        start = time.perf_counter()
+        atari.run_frames(num_frames, screens=screens)
+        results[fast] = num_frames / (time.perf_counter() - start)
+        frames[fast] = [screens[k * frame_size:(k + 1) * frame_size]
+                        for k in range(num_frames)]
+    num_mismatches = sum(a != b for a, b in zip(frames[False], frames[True]))
+    return results, num_mismatches
+
+
+def bench_native(min_seconds, filter=""):
+    """Run the native microbenchmarks of the chips, the cartridges, the state
+    serialization and the full system, and return their results as a list of
+    dictionaries. See `jigo2600.get_benchmark_names()` for the cases."""
+    return json.loads(jigo2600.run_benchmarks(min_seconds, filter))
+
+
+# -------------------------------------------------------------------
+# Driver
+# -------------------------------------------------------------------
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("CART", nargs="?", help="cartridge binary file")
+    parser.add_argument("-n", "--num-frames", type=int, default=600,
+                        help="number of frames to simulate")
+    parser.add_argument("--native", action="store_true",
+                        help="run the native microbenchmarks and print one JSON "
+                        "object per case")
+    parser.add_argument("--filter", default="",
+                        help="run only the native cases whose name contains this")
+    parser.add_argument("--min-seconds", type=float, default=0.25,
+                        help="minimum duration of each native case")
+    args = parser.parse_args()
+    if not args.native and args.CART is None:
+        parser.error("a cartridge is required unless --native is given")
+
+    if args.native:
+        for result in bench_native(args.min_seconds, args.filter):
+            print(json.dumps(result, sort_keys=True))
+        if args.CART is None:
+            sys.exit()
+
+    with open(args.CART, "rb") as f:
+        cart_bytes = f.read()
+
+    results = bench_render_modes(cart_bytes, args.num_frames)
+    base = results["FULL"]
+    for name, fps in results.items():
+        print(f"{name:25s} {fps:8.1f} fps ({fps / base:.2f}x)")
+
+    for option in ("fast_scanline", "fast_cpu", "fast_wsync",
+                   "static_cartridge_dispatch"):
+        results, num_mismatches = bench_option(cart_bytes, args.num_frames, option)
+        print(f"{option.upper():25s} {results[True]:8.1f} fps "
+              f"({results[True] / results[False]:.2f}x, {num_mismatches} frames differ)")
@@ -0,0 +1,95 @@
+#  bus_trace.py
+#  Bus trace recording and decoding
+
+# Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+# This file is part of Jigo2600 and is made available under
+# the terms of the BSD license (see the COPYING file).
+
+import argparse
+import struct
+import sys
+
+import jigo2600
+from jigo2600 import Atari2600
+
+RECORD_SIZE = struct.calcsize(jigo2600.Atari2600TraceRecorder.RECORD_FORMAT)
+
+# -------------------------------------------------------------------
+# Recording
+# -------------------------------------------------------------------
+
+
+def record_trace(cart_bytes, num_frames, path, capacity=1 << 20):
+    """Emulate `num_frames` frames and write the bus cycles to the trace file
+    at `path`. Return the number of records."""
+    atari = Atari2600()
+    atari.cartridge = jigo2600.make_cartridge_from_bytes(cart_bytes)
+    recorder = jigo2600.Atari2600TraceRecorder(capacity)
+    recorder.open(path)
+    atari.set_trace_recorder(recorder)
+    atari.run_frames(num_frames)
+    atari.set_trace_recorder(None)
+    recorder.close()
+    return recorder.num_records
+
+
+# -------------------------------------------------------------------
+# Decoding
+# -------------------------------------------------------------------
+
+
+def print_trace(source, sink, start=0, count=None, chunk_size=1 << 16):
+    """Disassemble `count` records of the trace file `source`, starting at
+    record `start`, to `sink`. The last records of each chunk are carried over
+    to the next one, so that the instructions are decoded across chunks."""
+    lookahead = 2 * RECORD_SIZE
+    source.seek(start * RECORD_SIZE)
+    pending = b""
+    while count is None or count > 0:
+        n = chunk_size if count is None else min(chunk_size, count)
+        data = source.read(n * RECORD_SIZE + lookahead - len(pending))
+        chunk = pending + data
+        num_records = len(chunk) // RECORD_SIZE
+        if num_records == 0:
+            break
+        num_printed = min(n, num_records) if data else num_records
+        sink.write(jigo2600.format_trace(chunk, num_printed))
+        pending = chunk[num_printed * RECORD_SIZE:num_records * RECORD_SIZE]
+        if count is not None:
+            count -= num_printed
+        if not data:
+            break
+
+
+# -------------------------------------------------------------------
+# Driver
+# -------------------------------------------------------------------
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    commands = parser.add_subparsers(dest="command")
+    commands.required = True
+    rec = commands.add_parser("record", help="record a trace")
+    rec.add_argument("CART", help="cartridge binary file")
+    rec.add_argument("OUTPUT", help="output trace file")
+    rec.add_argument("-n", "--num-frames", type=int, default=1,
+                     help="number of frames to simulate")
+    dec = commands.add_parser("print", help="disassemble a trace")
+    dec.add_argument("TRACE", help="trace file")
+    dec.add_argument("-s", "--start", type=int, default=0,
+                     help="index of the first record to print")
+    dec.add_argument("-c", "--count", type=int,
+                     help="number of records to print (default: all)")
+    args = parser.parse_args()
+
+    if args.command == "record":
+        with open(args.CART, "rb") as f:
+            cart_bytes = f.read()
+        num_records = record_trace(cart_bytes, args.num_frames, args.OUTPUT)
+        print(f"Recorded {num_records} bus cycles")
+    else:
+        with open(args.TRACE, "rb") as f:
+            try:
+                print_trace(f, sys.stdout, args.start, args.count)
+            except BrokenPipeError:
+                pass
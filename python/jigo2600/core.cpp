@@ -6,8 +6,20 @@
 // the terms of the BSD license (see the COPYING file).
 
 #include <Atari2600.hpp>
+#include <Atari2600Benchmark.hpp>
+#include <Atari2600Profiler.hpp>
+#include <Atari2600Rewind.hpp>
+#include <Atari2600Rollback.hpp>
+#include <Atari2600SelfTest.hpp>
+#include <Atari2600Trace.hpp>
+#include <Atari2600Vector.hpp>
 #include <M6502Disassembler.hpp>
+#include <TIAObservation.hpp>
+#include <TIASoundRecorder.hpp>
+#include <TIASoundSynthesizer.hpp>
+#include <TIAStrobeHistogram.hpp>
 #include <cstdint>
+#include <cstring>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <sstream>
@@ -48,6 +60,45 @@ struct VideoFrame {
   uint32_t const* argb;
 };
 
+/// Get a pointer to the data of a C-contiguous buffer of at least `numBytes` bytes.
+/// A `None` object maps to a null pointer.
+void* contiguousBuffer(py::object obj, size_t numBytes, bool writable) {
+  if (obj.is_none()) return nullptr;
+  auto info = py::buffer(obj).request(writable);
+  auto stride = info.itemsize;
+  for (auto k = info.ndim; k > 0; --k) {
+    if (info.strides[k - 1] != stride) {
+      throw std::runtime_error("Incompatible format: expected a C-contiguous buffer.");
+    }
+    stride *= info.shape[k - 1];
+  }
+  if (static_cast<size_t>(info.size * info.itemsize) < numBytes) {
+    throw std::runtime_error("Buffer too small.");
+  }
+  return info.ptr;
+}
+
+/// Unpack a frame input from a buffer in the FRAME_INPUT_FORMAT layout.
+Atari2600::FrameInput frameInput(py::object obj) {
+  if (obj.is_none()) throw std::runtime_error("Expected a packed frame input.");
+  return *static_cast<Atari2600::FrameInput const*>(
+      contiguousBuffer(obj, sizeof(Atari2600::FrameInput), false));
+}
+
+struct IndexedVideoFrame {
+  IndexedVideoFrame(std::shared_ptr<const Atari2600> simulator, int time)
+   : simulator(simulator) {
+    assert(simulator);
+    if (time >= 0) {
+      indices = simulator->getTia()->getCurrentIndexedScreen();
+    } else {
+      indices = simulator->getTia()->getLastIndexedScreen();
+    }
+  }
+  std::shared_ptr<const Atari2600> simulator;
+  uint8_t const* indices;
+};
+
 struct CartridgeTypeMismatchException : public std::exception {
   virtual const char* what() const noexcept override {
     return "Cartridge type mismatch.";
@@ -62,6 +113,7 @@ enum class Atari2600StoppingReason {
   frameDone = Atari2600::StoppingReason::frameDone,
   breakpoint = Atari2600::StoppingReason::breakpoint,
   numClocksReached = Atari2600::StoppingReason::numCyclesReached,
+  watchpoint = Atari2600::StoppingReason::watchpoint,
 };
 
 vector<Atari2600StoppingReason> to_vector(Atari2600::StoppingReason const& r) {
@@ -71,6 +123,7 @@ vector<Atari2600StoppingReason> to_vector(Atari2600::StoppingReason const& r) {
   if (r[in::frameDone]) r_.push_back(out::frameDone);
   if (r[in::breakpoint]) r_.push_back(out::breakpoint);
   if (r[in::numCyclesReached]) r_.push_back(out::numClocksReached);
+  if (r[in::watchpoint]) r_.push_back(out::watchpoint);
   return r_;
 }
 
@@ -292,7 +345,30 @@ PYBIND11_MODULE(core, m) {
       .def_static("decode_address", &TIAState::decodeAddress);
 
   py::class_<TIA, shared_ptr<TIA>> tia(m, "TIA", tiaState);
-  tia.def(py::init<>()).def_readwrite("num_cycles", &TIA::numCycles);
+  tia.def(py::init<>())
+      .def_readwrite("num_cycles", &TIA::numCycles)
+      .def_property("render_mode", &TIA::getRenderMode, &TIA::setRenderMode)
+      .def_property("audio_mode", &TIA::getAudioMode, &TIA::setAudioMode)
+      .def("set_strobe_histogram", &TIA::setStrobeHistogram,
+           "Map the register strobes of each frame with the given histogram (or "
+           "None).",
+           "histogram"_a, py::keep_alive<1, 2>())
+      .def_property_readonly("palette",
+                             [](const TIA& self) {
+                               auto palette = self.getPalette();
+                               return vector<uint32_t>(palette, palette + 128);
+                             });
+
+  py::enum_<TIA::RenderMode>(tia, "RenderMode")
+      .value("FULL", TIA::RenderMode::full)
+      .value("INDEXED", TIA::RenderMode::indexed)
+      .value("COLLISIONS_ONLY", TIA::RenderMode::collisionsOnly)
+      .value("NONE", TIA::RenderMode::none);
+
+  py::enum_<TIA::AudioMode>(tia, "AudioMode")
+      .value("OFF", TIA::AudioMode::off)
+      .value("SAMPLES_ONLY", TIA::AudioMode::samplesOnly)
+      .value("FULL", TIA::AudioMode::full);
 
   py::enum_<TIA::VideoStandard>(tiaState, "VideoStandard")
       .value("NTSC", TIA::VideoStandard::NTSC)
@@ -363,6 +439,34 @@ PYBIND11_MODULE(core, m) {
       .value("NA2", TIA::Register::NA2)
       .value("VOID", TIA::Register::VOID);
 
+  py::class_<TIAStrobeHistogram, shared_ptr<TIAStrobeHistogram>> strobeHistogram(
+      m, "TIAStrobeHistogram");
+  strobeHistogram.def(py::init<>())
+      .def("clear", &TIAStrobeHistogram::clear)
+      .def_property_readonly("num_frames", &TIAStrobeHistogram::getNumFrames)
+      .def_property_readonly("counts",
+                             [](const TIAStrobeHistogram& self) {
+                               vector<uint32_t> counts(TIAStrobeHistogram::numRegisters);
+                               self.copyLastFrame(nullptr, counts.data());
+                               return counts;
+                             },
+                             "Number of strobes of each register in the last frame.")
+      .def("get_last_frame",
+           [](const TIAStrobeHistogram& self) {
+             size_t const size = TIAStrobeHistogram::width * TIAStrobeHistogram::height;
+             vector<uint8_t> frame(size);
+             self.copyLastFrame(frame.data(), nullptr);
+             py::bytes bytes(reinterpret_cast<char const*>(frame.data()), size);
+             return py::memoryview(bytes).attr("cast")(
+                 "B", py::make_tuple(int(TIAStrobeHistogram::height),
+                                     int(TIAStrobeHistogram::width)));
+           },
+           "Return a copy of the last complete frame as an uint8 [height, width] "
+           "array. The copy is consistent even if the emulation runs on another "
+           "thread.");
+
+  strobeHistogram.attr("NONE") = int(TIAStrobeHistogram::none);
+
   // ----------------------------------------------------------------
   // MARK: Cartridge
   // ----------------------------------------------------------------
@@ -408,16 +512,109 @@ PYBIND11_MODULE(core, m) {
         "Make a new Atari2600 cartridge from a binary blob.", "bytes"_a,
         "type"_a = Atari2600Cartridge::Type::unknown);
 
+  m.def("get_benchmark_names", &getAtari2600BenchmarkNames,
+        "Get the names of the native benchmark cases.");
+
+  m.def("run_benchmarks",
+        [](double min_seconds, string const& filter) {
+          vector<Atari2600BenchmarkResult> results;
+          {
+            py::gil_scoped_release release;
+            results = runAtari2600Benchmarks(min_seconds, filter);
+          }
+          return json(results).dump();
+        },
+        "Run the native benchmark cases whose name contains `filter`, each for at "
+        "least `min_seconds`, and return the results as a JSON array.",
+        "min_seconds"_a = 0.25, "filter"_a = "");
+
+  m.def("get_self_test_names", &getAtari2600SelfTestNames,
+        "Get the names of the native self-test cases.");
+
+  m.def("run_self_tests",
+        [](string const& filter) {
+          vector<Atari2600SelfTestResult> results;
+          {
+            py::gil_scoped_release release;
+            results = runAtari2600SelfTests(filter);
+          }
+          return json(results).dump();
+        },
+        "Run the native self-test cases whose name contains `filter` and return the "
+        "results as a JSON array.",
+        "filter"_a = "");
+
   py::class_<Atari2600State, shared_ptr<Atari2600State>>(m, "Atari2600State")
       .def(py::init<>())
       .def("to_json", [](const Atari2600State& self) -> string { return to_json(self); })
       .def("from_json",
-           [](Atari2600State& self, string const& str) { from_json(self, str); });
+           [](Atari2600State& self, string const& str) { from_json(self, str); })
+      .def("to_binary",
+           [](const Atari2600State& self) {
+             vector<uint8_t> bytes;
+             BinaryWriter w(bytes);
+             to_binary(w, self);
+             return py::bytes(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+           })
+      .def("from_binary", [](Atari2600State& self, py::bytes const& data) {
+        auto str = string(data);
+        auto begin = reinterpret_cast<uint8_t const*>(str.data());
+        BinaryReader r(begin, begin + str.size());
+        from_binary(r, self);
+      });
+
+  py::class_<Atari2600Snapshot>(m, "Atari2600Snapshot").def(py::init<>());
 
   // ----------------------------------------------------------------
   // MARK: Emulator
   // ----------------------------------------------------------------
 
+  py::class_<Atari2600Condition> condition(m, "Condition");
+
+  py::enum_<Atari2600Condition::Operand>(condition, "Operand")
+      .value("ALWAYS", Atari2600Condition::Operand::always)
+      .value("A", Atari2600Condition::Operand::A)
+      .value("X", Atari2600Condition::Operand::X)
+      .value("Y", Atari2600Condition::Operand::Y)
+      .value("S", Atari2600Condition::Operand::S)
+      .value("P", Atari2600Condition::Operand::P)
+      .value("MEMORY", Atari2600Condition::Operand::memory)
+      .value("DATA", Atari2600Condition::Operand::data);
+
+  py::enum_<Atari2600Condition::Comparison>(condition, "Comparison")
+      .value("EQUAL", Atari2600Condition::Comparison::equal)
+      .value("NOT_EQUAL", Atari2600Condition::Comparison::notEqual)
+      .value("LESS", Atari2600Condition::Comparison::less)
+      .value("LESS_OR_EQUAL", Atari2600Condition::Comparison::lessOrEqual)
+      .value("GREATER", Atari2600Condition::Comparison::greater)
+      .value("GREATER_OR_EQUAL", Atari2600Condition::Comparison::greaterOrEqual);
+
+  condition
+      .def(py::init([](Atari2600Condition::Operand operand,
+                       Atari2600Condition::Comparison comparison, uint8_t value,
+                       uint8_t mask, uint32_t address) {
+             return Atari2600Condition{operand, comparison, mask, value, address};
+           }),
+           "operand"_a = Atari2600Condition::Operand::always,
+           "comparison"_a = Atari2600Condition::Comparison::equal, "value"_a = 0,
+           "mask"_a = 0xff, "address"_a = 0)
+      .def_readwrite("operand", &Atari2600Condition::operand)
+      .def_readwrite("comparison", &Atari2600Condition::comparison)
+      .def_readwrite("value", &Atari2600Condition::value)
+      .def_readwrite("mask", &Atari2600Condition::mask)
+      .def_readwrite("address", &Atari2600Condition::address);
+
+  py::class_<Atari2600WatchPoint>(m, "WatchPoint")
+      .def_readonly("address", &Atari2600WatchPoint::address)
+      .def_readonly("write", &Atari2600WatchPoint::write)
+      .def_readonly("condition", &Atari2600WatchPoint::condition);
+
+  py::class_<Atari2600WatchPointHit>(m, "WatchPointHit")
+      .def_readonly("cycle", &Atari2600WatchPointHit::cycle)
+      .def_readonly("address", &Atari2600WatchPointHit::address)
+      .def_readonly("data", &Atari2600WatchPointHit::data)
+      .def_readonly("write", &Atari2600WatchPointHit::write);
+
   py::class_<Atari2600, shared_ptr<Atari2600>> atari2600(m, "Atari2600");
   atari2600.def(py::init<>())
       .def("cycle",
@@ -425,29 +622,44 @@ PYBIND11_MODULE(core, m) {
              auto r = self.cycle(max_num_cpu_cycles);
              return py::make_tuple(to_vector(r), max_num_cpu_cycles);
            })
+      .def("run_frames",
+           [](Atari2600& self, size_t num_frames, py::object inputs, py::object screens,
+              size_t max_num_cpu_cycles_per_frame) {
+             auto inputs_ = static_cast<Atari2600::FrameInput const*>(contiguousBuffer(
+                 inputs, num_frames * sizeof(Atari2600::FrameInput), false));
+             auto screens_ = static_cast<uint32_t*>(contiguousBuffer(
+                 screens, num_frames * TIA::screenWidth * TIA::screenHeight * 4, true));
+             Atari2600::StoppingReason r;
+             {
+               py::gil_scoped_release release;
+               r = self.runFrames(num_frames, inputs_, screens_,
+                                  max_num_cpu_cycles_per_frame);
+             }
+             return py::make_tuple(to_vector(r), num_frames);
+           },
+           "Run several frames, applying packed per-frame inputs (see "
+           "FRAME_INPUT_FORMAT) and copying each frame into an uint8 [N,H,W,4] "
+           "buffer.",
+           "num_frames"_a, "inputs"_a = py::none(), "screens"_a = py::none(),
+           "max_num_cpu_cycles_per_frame"_a = size_t(Atari2600::maxNumCPUCyclesPerFrame))
       .def("get_current_frame",
            [](shared_ptr<const Atari2600> self) { return VideoFrame(self, 0); })
       .def("get_last_frame",
            [](shared_ptr<const Atari2600> self) { return VideoFrame(self, -1); })
-      .def("get_audio_samples",
-           [](Atari2600& self, py::buffer b, double nominalRate) {
-             auto info = b.request();
-             // if (info.format != py::format_descriptor<uint8_t>::format()) {
-             //   throw std::runtime_error("Incompatible format: expected a char buffer.")
-             //   ;
-             // }
-             if (info.itemsize != 1 || info.ndim != 1 || info.strides[0] != 1) {
-               throw std::runtime_error(
-                   "Incompatible format: expected a 1D linear buffer of bytes.");
-             }
-             auto begin = static_cast<uint8_t*>(info.ptr);
-             auto end = begin + info.shape[0];
-             self.getTia()->getSound(0).resample(begin, end, false, nominalRate);
-             self.getTia()->getSound(1).resample(begin, end, true, nominalRate);
-           })
+      .def("get_current_indexed_frame",
+           [](shared_ptr<const Atari2600> self) { return IndexedVideoFrame(self, 0); })
+      .def("get_last_indexed_frame",
+           [](shared_ptr<const Atari2600> self) { return IndexedVideoFrame(self, -1); })
       .def_property("video_standard", &Atari2600::getVideoStandard,
                     &Atari2600::setVideoStandard)
       .def_property("cartridge", &Atari2600::getCartridge, &Atari2600::setCartridge)
+      .def_property("fast_scanline", &Atari2600::getFastScanline,
+                    &Atari2600::setFastScanline)
+      .def_property("fast_cpu", &Atari2600::getFastCPU, &Atari2600::setFastCPU)
+      .def_property("fast_wsync", &Atari2600::getFastWSYNC, &Atari2600::setFastWSYNC)
+      .def_property("static_cartridge_dispatch",
+                    &Atari2600::getStaticCartridgeDispatch,
+                    &Atari2600::setStaticCartridgeDispatch)
       .def_property_readonly("frame_number", &Atari2600::getFrameNumber)
       .def_property_readonly("color_cycle_number", &Atari2600::getColorCycleNumber)
       .def_property_readonly("color_clock_rate", &Atari2600::getColorClockRate)
@@ -462,28 +674,83 @@ PYBIND11_MODULE(core, m) {
              }
            })
       .def("save_state", &Atari2600::saveState)
+      .def("save_state_into", &Atari2600::saveStateInto)
+      .def("load_state_from",
+           [](Atari2600& self, const Atari2600Snapshot& snapshot) {
+             if (self.loadStateFrom(snapshot) != Atari2600Error::success) {
+               throw CartridgeTypeMismatchException();
+             }
+           })
       .def("make_state", &Atari2600::makeState)
       .def("get_panel", &Atari2600::getPanel)
       .def("set_panel", &Atari2600::setPanel)
       .def("set_joystick", &Atari2600::setJoystick)
       .def("set_paddle", &Atari2600::setPaddle)
       .def("virtualize_address", &Atari2600::virtualizeAddress)
-      .def("set_breakpoint", &Atari2600::setBreakPoint)
-      .def("clear_breakpoint", &Atari2600::clearBreakPoint)
+      .def("set_breakpoint", &Atari2600::setBreakPoint, "virtual_address"_a,
+           "temporary"_a = false, "condition"_a = Atari2600Condition())
+      .def("clear_breakpoint", &Atari2600::clearBreakPoint, "virtual_address"_a,
+           "temporary"_a = false)
       .def("set_breakpoint_on_next_instruction",
            &Atari2600::setBreakPointOnNextInstruction)
       .def("clear_break_on_next_instruction",
            &Atari2600::clearBreakPointOnNextInstruction)
+      .def("set_watchpoint", &Atari2600::setWatchPoint,
+           "Stop after an access to the TIA register, PIA register, or RAM byte at "
+           "`address` for which `condition` holds.",
+           "address"_a, "read"_a = true, "write"_a = true,
+           "condition"_a = Atari2600Condition())
+      .def("clear_watchpoint", &Atari2600::clearWatchPoint, "address"_a,
+           "read"_a = true, "write"_a = true)
+      .def_property_readonly("watchpoints",
+                             [](const Atari2600& self) {
+                               vector<Atari2600WatchPoint> wps;
+                               for (auto const& wp : self.getWatchPoints()) {
+                                 wps.push_back(wp.second);
+                               }
+                               return wps;
+                             })
+      .def_property_readonly("last_watchpoint_hit", &Atari2600::getLastWatchPointHit)
+      .def("evaluate", &Atari2600::evaluate, "condition"_a, "data"_a = 0)
       .def_property_readonly("cpu", [](const Atari2600& self) { return self.getCpu(); })
       .def_property_readonly("pia", [](const Atari2600& self) { return self.getPia(); })
       .def_property_readonly("tia", [](const Atari2600& self) { return self.getTia(); })
-      //    .def("peek_virtual_address", &)
+      .def("set_observation",
+           [](Atari2600& self, TIAObservation* observation) {
+             self.getTia()->setObservation(observation);
+           },
+           "Process each completed frame with the given observation pipeline "
+           "(or None).",
+           "observation"_a, py::keep_alive<1, 2>())
+      .def("set_sound_recorder",
+           [](Atari2600& self, TIASoundRecorder* recorder) {
+             self.getTia()->setSoundRecorder(recorder);
+           },
+           "Record the audio of each completed frame with the given recorder (or "
+           "None).",
+           "recorder"_a, py::keep_alive<1, 2>())
+      .def("set_trace_recorder", &Atari2600::setTraceRecorder,
+           "Record each bus cycle with the given recorder (or None).", "recorder"_a,
+           py::keep_alive<1, 2>())
+      .def("set_profiler", &Atari2600::setProfiler,
+           "Profile the execution with the given profiler (or None).", "profiler"_a,
+           py::keep_alive<1, 2>())
+      .def("peek", &Atari2600::peek,
+           "Read the RAM or ROM byte at the virtual address without side effects.",
+           "virtual_address"_a)
+      .def("poke", &Atari2600::poke,
+           "Write the RAM or ROM byte at the virtual address without side effects.",
+           "virtual_address"_a, "value"_a)
       ;
 
+  static_assert(sizeof(Atari2600::FrameInput) == 20, "Unexpected FrameInput layout.");
+  atari2600.attr("FRAME_INPUT_FORMAT") = "<BBBB4f";
+
   py::enum_<Atari2600StoppingReason>(atari2600, "StoppingReason")
       .value("FRAME_DONE", Atari2600StoppingReason::frameDone)
       .value("BREAKPOINT", Atari2600StoppingReason::breakpoint)
-      .value("NUM_CLOCKS_REACHED", Atari2600StoppingReason::numClocksReached);
+      .value("NUM_CLOCKS_REACHED", Atari2600StoppingReason::numClocksReached)
+      .value("WATCHPOINT", Atari2600StoppingReason::watchpoint);
 
   py::class_<VideoFrame, unique_ptr<VideoFrame>>(atari2600, "VideoFrame",
                                                  py::buffer_protocol())
@@ -499,6 +766,345 @@ PYBIND11_MODULE(core, m) {
             {sizeof(char) * 4 * TIA::screenWidth, sizeof(char) * 4, sizeof(char)});
       });
 
+  // ----------------------------------------------------------------
+  // MARK: Observation
+  // ----------------------------------------------------------------
+
+  py::class_<TIAObservation, shared_ptr<TIAObservation>>(m, "TIAObservation",
+                                                         py::dynamic_attr())
+      .def(py::init<int, int, bool, bool>(), "width"_a = 84, "height"_a = 84,
+           "grayscale"_a = true, "max_pool"_a = true)
+      .def_property_readonly("width", &TIAObservation::getWidth)
+      .def_property_readonly("height", &TIAObservation::getHeight)
+      .def_property_readonly("num_channels", &TIAObservation::getNumChannels)
+      .def_property_readonly("max_pool", &TIAObservation::getMaxPool)
+      .def("set_output",
+           [](py::object self, py::object buffer) {
+             auto& obs = self.cast<TIAObservation&>();
+             obs.setOutput(static_cast<uint8_t*>(
+                 contiguousBuffer(buffer, obs.getSize(), true)));
+             // Keep the buffer alive while the pipeline writes to it.
+             self.attr("_output") = buffer;
+           },
+           "Write the observations to a writable uint8 [H,W] or [H,W,3] buffer (or "
+           "None).",
+           "buffer"_a)
+      .def("reset", &TIAObservation::reset);
+
+  // ----------------------------------------------------------------
+  // MARK: Audio
+  // ----------------------------------------------------------------
+
+  py::class_<TIASoundSynthesizer, shared_ptr<TIASoundSynthesizer>>(
+      m, "TIASoundSynthesizer")
+      .def(py::init<double, double>(), "sample_rate"_a = 44100,
+           "clock_rate"_a = 3.579545e6)
+      .def_property_readonly("sample_rate", &TIASoundSynthesizer::getSampleRate)
+      .def_property("clock_rate", &TIASoundSynthesizer::getClockRate,
+                    &TIASoundSynthesizer::setClockRate)
+      .def_property_readonly("num_available", &TIASoundSynthesizer::getNumAvailable)
+      .def("pull",
+           [](TIASoundSynthesizer& self, Atari2600& atari) {
+             auto tia = atari.getTia();
+             return self.pull(tia->getSound(0), tia->getSound(1));
+           },
+           "Consume the audio simulated so far and return the number of samples "
+           "available.",
+           "atari"_a)
+      .def("read",
+           [](TIASoundSynthesizer& self, py::buffer buffer) {
+             auto info = buffer.request(true);
+             if (info.ndim != 1 || info.strides[0] != info.itemsize) {
+               throw std::runtime_error(
+                   "Incompatible format: expected a 1D linear buffer.");
+             }
+             auto numSamples = static_cast<size_t>(info.shape[0]);
+             if (info.itemsize == 4 && info.format.back() == 'f') {
+               return self.read(static_cast<float*>(info.ptr), numSamples);
+             } else if (info.itemsize == 2 && info.format.back() == 'h') {
+               return self.read(static_cast<int16_t*>(info.ptr), numSamples);
+             }
+             throw std::runtime_error(
+                 "Incompatible format: expected a float32 or int16 buffer.");
+           },
+           "Fill a float32 or int16 buffer with samples and return the number of "
+           "samples available; the rest is padded with the last sample.",
+           "buffer"_a)
+      .def("clear", &TIASoundSynthesizer::clear);
+
+  py::class_<TIASoundRecorder, shared_ptr<TIASoundRecorder>>(m, "TIASoundRecorder")
+      .def(py::init<double, double, bool>(), "sample_rate"_a = 44100,
+           "clock_rate"_a = 3.579545e6, "float_samples"_a = false)
+      .def_property_readonly("sample_rate", &TIASoundRecorder::getSampleRate)
+      .def_property_readonly("clock_rate", &TIASoundRecorder::getClockRate)
+      .def_property_readonly("float_samples", &TIASoundRecorder::getFloatSamples)
+      .def_property_readonly("sample_size", &TIASoundRecorder::getSampleSize)
+      .def_property_readonly("num_samples", &TIASoundRecorder::getNumSamples)
+      .def_property_readonly("num_overflows", &TIASoundRecorder::getNumOverflows)
+      .def("update",
+           [](TIASoundRecorder& self, Atari2600& atari) {
+             auto tia = atari.getTia();
+             self.update(tia->getSound(0), tia->getSound(1));
+           },
+           "Record the audio simulated so far, without waiting for the end of the "
+           "frame.",
+           "atari"_a)
+      .def("take",
+           [](TIASoundRecorder& self) {
+             auto data = self.take();
+             return py::bytes(reinterpret_cast<char const*>(data.data()), data.size());
+           },
+           "Return the little-endian PCM data recorded since the last call.")
+      .def("clear", &TIASoundRecorder::clear);
+
+  // ----------------------------------------------------------------
+  // MARK: Rewind
+  // ----------------------------------------------------------------
+
+  py::class_<Atari2600Rewind, shared_ptr<Atari2600Rewind>>(m, "Atari2600Rewind")
+      .def(py::init<shared_ptr<Atari2600>, size_t, size_t>(), "machine"_a, "capacity"_a,
+           "keyframe_interval"_a = 60)
+      .def("__len__", &Atari2600Rewind::size)
+      .def("capture", &Atari2600Rewind::capture)
+      .def("seek", &Atari2600Rewind::seek)
+      .def("clear", &Atari2600Rewind::clear)
+      .def_property_readonly("capacity", &Atari2600Rewind::getCapacity)
+      .def_property_readonly("first_frame_number", &Atari2600Rewind::getFirstFrameNumber)
+      .def_property_readonly("last_frame_number", &Atari2600Rewind::getLastFrameNumber)
+      .def_property_readonly("num_bytes", &Atari2600Rewind::getNumBytes);
+
+  // ----------------------------------------------------------------
+  // MARK: Rollback
+  // ----------------------------------------------------------------
+
+  py::class_<Atari2600RollbackSession, shared_ptr<Atari2600RollbackSession>>(
+      m, "Atari2600RollbackSession")
+      .def(py::init<shared_ptr<Atari2600>, size_t, int>(), "machine"_a,
+           "max_num_rollback_frames"_a = 8, "local_player"_a = 0)
+      .def("set_local_input",
+           [](Atari2600RollbackSession& self, py::object input) {
+             self.setLocalInput(frameInput(input));
+           },
+           "Set the packed input of the local player (see FRAME_INPUT_FORMAT) for the "
+           "next frame.",
+           "input"_a)
+      .def("set_remote_input",
+           [](Atari2600RollbackSession& self, long long frame_number, py::object input) {
+             self.setRemoteInput(frame_number, frameInput(input));
+           },
+           "Set the packed input of the remote player for a frame, rolling back at the "
+           "next frame if it was mispredicted.",
+           "frame_number"_a, "input"_a)
+      .def("advance_frame",
+           [](Atari2600RollbackSession& self, size_t max_num_cpu_cycles) {
+             Atari2600::StoppingReason r;
+             {
+               py::gil_scoped_release release;
+               r = self.advanceFrame(max_num_cpu_cycles);
+             }
+             return to_vector(r);
+           },
+           "Run the next frame, after simulating again the mispredicted ones.",
+           "max_num_cpu_cycles"_a = size_t(Atari2600::maxNumCPUCyclesPerFrame))
+      .def_property_readonly("frame_number", &Atari2600RollbackSession::getFrameNumber)
+      .def_property_readonly("last_remote_frame_number",
+                             &Atari2600RollbackSession::getLastRemoteFrameNumber)
+      .def_property_readonly("max_num_rollback_frames",
+                             &Atari2600RollbackSession::getMaxNumRollbackFrames)
+      .def_property_readonly("local_player", &Atari2600RollbackSession::getLocalPlayer)
+      .def_property_readonly("num_rollbacks", &Atari2600RollbackSession::getNumRollbacks)
+      .def_property_readonly("num_resimulated_frames",
+                             &Atari2600RollbackSession::getNumResimulatedFrames);
+
+  // ----------------------------------------------------------------
+  // MARK: Trace
+  // ----------------------------------------------------------------
+
+  py::class_<Atari2600TraceRecorder, shared_ptr<Atari2600TraceRecorder>> traceRecorder(
+      m, "Atari2600TraceRecorder");
+  traceRecorder.def(py::init<size_t>(), "capacity"_a = (1 << 16))
+      .def("__len__", &Atari2600TraceRecorder::size)
+      .def("open", &Atari2600TraceRecorder::open,
+           "Write the records to the file at `path` from a background thread.",
+           "path"_a, py::call_guard<py::gil_scoped_release>())
+      .def("close", &Atari2600TraceRecorder::close,
+           "Write the remaining records and close the file.",
+           py::call_guard<py::gil_scoped_release>())
+      .def("drain",
+           [](Atari2600TraceRecorder& self, size_t max_num_records) {
+             if (self.isOpen()) {
+               throw runtime_error("Cannot drain a trace recorder writing to a file");
+             }
+             vector<Atari2600TraceRecord> records(min(max_num_records, self.size()));
+             records.resize(self.drain(records.data(), records.size()));
+             return py::bytes(reinterpret_cast<char const*>(records.data()),
+                              records.size() * sizeof(Atari2600TraceRecord));
+           },
+           "Remove and return up to `max_num_records` of the oldest records.",
+           "max_num_records"_a = SIZE_MAX)
+      .def_property_readonly("is_open", &Atari2600TraceRecorder::isOpen)
+      .def_property_readonly("capacity", &Atari2600TraceRecorder::getCapacity)
+      .def_property_readonly("num_records", &Atari2600TraceRecorder::getNumRecords)
+      .def_property_readonly("num_dropped", &Atari2600TraceRecorder::getNumDropped);
+
+  static_assert(sizeof(Atari2600TraceRecord) == 16, "Unexpected trace record layout.");
+  traceRecorder.attr("RECORD_FORMAT") = "<QHBBBBH";
+
+  m.def("format_trace",
+        [](py::bytes const& data, size_t num_printed) {
+          auto str = string(data);
+          auto records = vector<Atari2600TraceRecord>(str.size() /
+                                                      sizeof(Atari2600TraceRecord));
+          memcpy(records.data(), str.data(),
+                 records.size() * sizeof(Atari2600TraceRecord));
+          ostringstream os;
+          printTrace(os, records.data(), records.size(), num_printed);
+          return os.str();
+        },
+        "Disassemble the first `num_printed` records of the trace `data`, using the "
+        "following ones to decode the last instructions.",
+        "data"_a, "num_printed"_a = SIZE_MAX);
+
+  // ----------------------------------------------------------------
+  // MARK: Profiler
+  // ----------------------------------------------------------------
+
+  using P = Atari2600Profiler;
+  auto counters = [](uint64_t const* data) {
+    return py::memoryview(py::buffer_info(const_cast<uint64_t*>(data), sizeof(uint64_t),
+                                          py::format_descriptor<uint64_t>::format(), 1,
+                                          {P::numAddresses}, {sizeof(uint64_t)}));
+  };
+
+  py::class_<P, shared_ptr<P>>(m, "Atari2600Profiler")
+      .def(py::init<>())
+      .def("clear", &P::clear)
+      .def_property_readonly("total_num_instructions", &P::getTotalNumInstructions)
+      .def_property_readonly("total_num_cycles", &P::getTotalNumCycles)
+      .def_property_readonly(
+          "num_instructions",
+          [counters](P const& self) { return counters(self.getNumInstructions()); },
+          "Instructions executed, indexed by `get_index()`.")
+      .def_property_readonly(
+          "num_cycles",
+          [counters](P const& self) { return counters(self.getNumCycles()); },
+          "Cycles spent, including the stalled ones, indexed by `get_index()`.")
+      .def_property_readonly(
+          "num_stalled_cycles",
+          [counters](P const& self) { return counters(self.getNumStalledCycles()); },
+          "Cycles stalled by WSYNC, indexed by `get_index()`.")
+      .def_property_readonly(
+          "heatmap",
+          [](P const& self) {
+            return py::memoryview(py::buffer_info(
+                const_cast<uint32_t*>(self.getHeatmap()), sizeof(uint32_t),
+                py::format_descriptor<uint32_t>::format(), 3,
+                {2, P::numLines, P::numLineCycles},
+                {sizeof(uint32_t) * P::numLines * P::numLineCycles,
+                 sizeof(uint32_t) * P::numLineCycles, sizeof(uint32_t)}));
+          },
+          "Executed and stalled cycles as an uint32 [2,lines,cycles] array.")
+      .def_static("get_index", &P::getIndex, "virtual_address"_a)
+      .def_static("get_virtual_address", &P::getVirtualAddress, "index"_a)
+      .def("get_flat_profile",
+           [](P const& self) {
+             vector<py::tuple> entries;
+             for (auto const& e : self.getFlatProfile()) {
+               entries.push_back(py::make_tuple(e.virtualAddress, e.numInstructions,
+                                                e.numCycles, e.numStalledCycles));
+             }
+             return entries;
+           },
+           "Return (virtual_address, num_instructions, num_cycles, "
+           "num_stalled_cycles) tuples by decreasing number of cycles.")
+      .def("format",
+           [](P const& self, Atari2600 const& atari, size_t max_num_entries) {
+             ostringstream os;
+             printProfile(os, atari, self, max_num_entries);
+             return os.str();
+           },
+           "Format the flat profile, disassembling the instructions from `atari`.",
+           "atari"_a, "max_num_entries"_a = 40);
+
+  // ----------------------------------------------------------------
+  // MARK: Emulator vector
+  // ----------------------------------------------------------------
+
+  py::class_<Atari2600Vector, shared_ptr<Atari2600Vector>>(m, "Atari2600Vector",
+                                                           py::buffer_protocol())
+      .def(py::init<size_t>(), "num_threads"_a = 0)
+      .def("__len__", &Atari2600Vector::size)
+      .def("add_machine", &Atari2600Vector::addMachine,
+           "Add a machine and return its index. This reallocates the observations, "
+           "so that the arrays previously obtained through the buffer protocol must "
+           "not be used anymore. It is an error to call this during a step.",
+           "machine"_a)
+      .def("get_machine", &Atari2600Vector::getMachine)
+      .def_property_readonly("num_threads", &Atari2600Vector::getNumThreads)
+      .def("set_reward_function",
+           [](Atari2600Vector& self, py::function f) {
+             // Python hooks serialize the workers on the GIL; native ones do not.
+             self.setRewardFunction([f](size_t index, Atari2600 const&) {
+               py::gil_scoped_acquire acquire;
+               return f(index).cast<float>();
+             });
+           })
+      .def("set_done_function",
+           [](Atari2600Vector& self, py::function f) {
+             self.setDoneFunction([f](size_t index, Atari2600 const&) {
+               py::gil_scoped_acquire acquire;
+               return f(index).cast<bool>();
+             });
+           })
+      .def("step",
+           [](Atari2600Vector& self, py::object inputs) {
+             auto inputs_ = static_cast<Atari2600::FrameInput const*>(contiguousBuffer(
+                 inputs, self.size() * sizeof(Atari2600::FrameInput), false));
+             py::gil_scoped_release release;
+             self.step(inputs_);
+           },
+           "Step all machines by one frame. The observations are available through "
+           "the buffer protocol as an uint8 [N,H,W,4] array. A machine that stops "
+           "before the end of the frame (see get_stopping_reasons) is done.",
+           "inputs"_a = py::none())
+      .def("get_rewards",
+           [](const Atari2600Vector& self) {
+             return vector<float>(self.getRewards(), self.getRewards() + self.size());
+           })
+      .def("get_dones",
+           [](const Atari2600Vector& self) {
+             auto dones = self.getDones();
+             return vector<bool>(dones, dones + self.size());
+           })
+      .def("get_stopping_reasons",
+           [](const Atari2600Vector& self) {
+             vector<vector<Atari2600StoppingReason>> reasons;
+             for (size_t k = 0; k < self.size(); ++k) {
+               reasons.push_back(to_vector(self.getStoppingReasons()[k]));
+             }
+             return reasons;
+           })
+      .def_buffer([](Atari2600Vector& self) -> py::buffer_info {
+        return py::buffer_info(
+            const_cast<uint32_t*>(self.getObservations()), sizeof(char),
+            py::format_descriptor<const char>::format(), 4,
+            {py::ssize_t(self.size()), py::ssize_t(TIA::screenHeight),
+             py::ssize_t(TIA::screenWidth), py::ssize_t(4)},
+            {sizeof(char) * 4 * TIA::screenWidth * TIA::screenHeight,
+             sizeof(char) * 4 * TIA::screenWidth, sizeof(char) * 4, sizeof(char)});
+      });
+
+  py::class_<IndexedVideoFrame, unique_ptr<IndexedVideoFrame>>(
+      atari2600, "IndexedVideoFrame", py::buffer_protocol())
+      .def_property_readonly("width", [](py::object self) { return TIA::screenWidth; })
+      .def_property_readonly("height", [](py::object self) { return TIA::screenHeight; })
+      .def_buffer([](const IndexedVideoFrame& self) -> py::buffer_info {
+        return py::buffer_info(const_cast<uint8_t*>(self.indices), sizeof(uint8_t),
+                               py::format_descriptor<uint8_t>::format(), 2,
+                               {TIA::screenHeight, TIA::screenWidth},
+                               {sizeof(uint8_t) * TIA::screenWidth, sizeof(uint8_t)});
+      });
+
   // ----------------------------------------------------------------
   // MARK: Console panel
   // ----------------------------------------------------------------
@@ -144,13 +144,13 @@ class Emulator():
         if self.has_sdl_audio:
             self.audio_spec = sdl2.SDL_AudioSpec(
                 44100,
-                sdl2.AUDIO_U8,
+                sdl2.AUDIO_S16SYS,
                 1,
                 1024,
                 sdl2.SDL_AudioCallback(self.play_audio))
             self.audio_dev = sdl2.SDL_OpenAudioDevice(
                 None, 0, self.audio_spec, self.audio_spec, 0)
-            self.audio_buffer_rate = self.audio_spec.freq / self.audio_spec.samples
+            self.audio_synthesizer = jigo2600.TIASoundSynthesizer(self.audio_spec.freq)
             assert self.audio_spec.channels == 1
 
         # Setup the joysticks.
@@ -190,10 +190,12 @@ class Emulator():
         sdl2.SDL_Quit()
 
     def play_audio(self, _, buffer, buffer_size):
-        at = ctypes.c_uint8 * buffer_size
+        at = ctypes.c_int16 * (buffer_size // 2)
         array = ctypes.cast(buffer, ctypes.POINTER(at))
-        rate = self.atari.color_clock_rate / self.audio_buffer_rate * self.speed
-        self.atari.get_audio_samples(memoryview(array.contents), rate)
+        if self.speed > 0:
+            self.audio_synthesizer.clock_rate = self.atari.color_clock_rate * self.speed
+        self.audio_synthesizer.pull(self.atari)
+        self.audio_synthesizer.read(memoryview(array.contents))
 
     def load_cart(self, cart_path, cart_type=Cartridge.Type.UNKNOWN,
                   video_standard=None, peripheral_type=None):
@@ -0,0 +1,65 @@
+#  profile_rom.py
+#  Execution profiler
+
+# Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+# This file is part of Jigo2600 and is made available under
+# the terms of the BSD license (see the COPYING file).
+
+import argparse
+
+import jigo2600
+from jigo2600 import Atari2600
+
+# -------------------------------------------------------------------
+# Profiling
+# -------------------------------------------------------------------
+
+
+def profile_rom(cart_bytes, num_frames, fast=True):
+    "Emulate `num_frames` frames and return the machine and its profiler."
+    atari = Atari2600()
+    atari.cartridge = jigo2600.make_cartridge_from_bytes(cart_bytes)
+    atari.fast_scanline = fast
+    atari.fast_wsync = fast
+    profiler = jigo2600.Atari2600Profiler()
+    atari.set_profiler(profiler)
+    atari.run_frames(num_frames)
+    atari.set_profiler(None)
+    return atari, profiler
+
+
+def format_scanlines(profiler, num_frames):
+    """Format the average number of executed and stalled CPU cycles of each
+    scanline, skipping the lines with none."""
+    heatmap = profiler.heatmap
+    lines = []
+    for y in range(heatmap.shape[1]):
+        executed = sum(heatmap[0, y, x] for x in range(heatmap.shape[2]))
+        stalled = sum(heatmap[1, y, x] for x in range(heatmap.shape[2]))
+        if executed + stalled > 0:
+            lines.append(f"{y:4d} {executed / num_frames:6.1f} {stalled / num_frames:6.1f}")
+    return "line   busy  stall\n" + "\n".join(lines) + "\n"
+
+
+# -------------------------------------------------------------------
+# Driver
+# -------------------------------------------------------------------
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("CART", help="cartridge binary file")
+    parser.add_argument("-n", "--num-frames", type=int, default=600,
+                        help="number of frames to simulate")
+    parser.add_argument("-e", "--num-entries", type=int, default=40,
+                        help="number of addresses to print")
+    parser.add_argument("--scanlines", action="store_true",
+                        help="print the CPU cycles per scanline")
+    args = parser.parse_args()
+
+    with open(args.CART, "rb") as f:
+        cart_bytes = f.read()
+    atari, profiler = profile_rom(cart_bytes, args.num_frames)
+    print(profiler.format(atari, args.num_entries), end="")
+    if args.scanlines:
+        print()
+        print(format_scanlines(profiler, args.num_frames), end="")
@@ -0,0 +1,104 @@
+#  record_audio.py
+#  Offline audio recording
+
+# Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+# This file is part of Jigo2600 and is made available under
+# the terms of the BSD license (see the COPYING file).
+
+import argparse
+import struct
+import wave
+
+import jigo2600
+from jigo2600 import Atari2600, TIA
+
+# -------------------------------------------------------------------
+# Recording
+# -------------------------------------------------------------------
+
+
+def record_audio(cart_bytes, num_frames, sink, sample_rate=44100, float_samples=False,
+                 inputs=None, chunk_size=600):
+    """Emulate `num_frames` frames as fast as possible and write the audio to
+    `sink` as little-endian mono PCM. The samples depend only on the emulated
+    cycle count, so the output is identical at every run. `inputs`, if given,
+    holds one `Atari2600.FRAME_INPUT_FORMAT` record per frame. Raises
+    `RuntimeError` if the sound queues overflowed, which would make the
+    recording inexact."""
+    atari = Atari2600()
+    atari.cartridge = jigo2600.make_cartridge_from_bytes(cart_bytes)
+    atari.fast_scanline = True
+    atari.tia.render_mode = TIA.RenderMode.COLLISIONS_ONLY
+    recorder = jigo2600.TIASoundRecorder(sample_rate, atari.color_clock_rate,
+                                         float_samples)
+    atari.set_sound_recorder(recorder)
+    record_size = struct.calcsize(Atari2600.FRAME_INPUT_FORMAT)
+    for first in range(0, num_frames, chunk_size):
+        n = min(chunk_size, num_frames - first)
+        chunk = None
+        if inputs is not None:
+            chunk = inputs[first * record_size:(first + n) * record_size]
+        atari.run_frames(n, inputs=chunk)
+        recorder.update(atari)
+        sink.write(recorder.take())
+    atari.set_sound_recorder(None)
+    if recorder.num_overflows:
+        raise RuntimeError(f"The sound queues overflowed {recorder.num_overflows} times")
+    return recorder.num_samples
+
+
+class WaveSink:
+    "Write 16-bit mono PCM to a WAV file."
+
+    def __init__(self, path, sample_rate):
+        self.file = wave.open(path, "wb")
+        self.file.setnchannels(1)
+        self.file.setsampwidth(2)
+        self.file.setframerate(sample_rate)
+
+    def write(self, data):
+        self.file.writeframesraw(data)
+
+    def close(self):
+        self.file.close()
+
+
+# -------------------------------------------------------------------
+# Driver
+# -------------------------------------------------------------------
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("CART", help="cartridge binary file")
+    parser.add_argument("OUTPUT", help="output file (WAV, or raw PCM with --raw)")
+    parser.add_argument("-n", "--num-frames", type=int, default=3600,
+                        help="number of frames to simulate")
+    parser.add_argument("-r", "--sample-rate", type=int, default=44100,
+                        help="sample rate in Hz")
+    parser.add_argument("-i", "--inputs",
+                        help="file of per-frame inputs in FRAME_INPUT_FORMAT")
+    parser.add_argument("--raw", action="store_true",
+                        help="write headerless PCM instead of WAV")
+    parser.add_argument("--float", action="store_true",
+                        help="write 32-bit float samples (requires --raw)")
+    args = parser.parse_args()
+    if args.float and not args.raw:
+        parser.error("--float requires --raw")
+
+    with open(args.CART, "rb") as f:
+        cart_bytes = f.read()
+    inputs = None
+    if args.inputs:
+        with open(args.inputs, "rb") as f:
+            inputs = f.read()
+        if len(inputs) < args.num_frames * struct.calcsize(Atari2600.FRAME_INPUT_FORMAT):
+            parser.error("not enough inputs for the number of frames")
+
+    if args.raw:
+        sink = open(args.OUTPUT, "wb")
+    else:
+        sink = WaveSink(args.OUTPUT, args.sample_rate)
+    num_samples = record_audio(cart_bytes, args.num_frames, sink, args.sample_rate,
+                               args.float, inputs)
+    sink.close()
+    print(f"Recorded {num_samples} samples ({num_samples / args.sample_rate:.1f} s)")
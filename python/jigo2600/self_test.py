@@ -0,0 +1,43 @@
+#  self_test.py
+#  Emulator self tests
+
+# Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+# This file is part of Jigo2600 and is made available under
+# the terms of the BSD license (see the COPYING file).
+
+import argparse
+import json
+import sys
+
+import jigo2600
+
+# -------------------------------------------------------------------
+# Self tests
+# -------------------------------------------------------------------
+
+
+def run_self_tests(filter=""):
+    """Run the native self tests whose name contains `filter` and return their
+    results as a list of dictionaries. See `jigo2600.get_self_test_names()`
+    for the cases."""
+    return json.loads(jigo2600.run_self_tests(filter))
+
+
+# -------------------------------------------------------------------
+# Driver
+# -------------------------------------------------------------------
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--filter", default="",
+                        help="run only the cases whose name contains this")
+    args = parser.parse_args()
+
+    num_failed = 0
+    for result in run_self_tests(args.filter):
+        status = "ok" if result["passed"] else "FAILED"
+        print(f"{result['name']:30s} {status:6s} {result['numChecks']:8d} checks")
+        if not result["passed"]:
+            print(f"  {result['message']}")
+            num_failed += 1
+    sys.exit(1 if num_failed else 0)
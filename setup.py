@@ -70,12 +70,23 @@ setup(
             [
                 'python/jigo2600/core.cpp',
                 'src/Atari2600.cpp',
+                'src/Atari2600Benchmark.cpp',
                 'src/Atari2600Cartridge.cpp',
+                'src/Atari2600Profiler.cpp',
+                'src/Atari2600Rewind.cpp',
+                'src/Atari2600Rollback.cpp',
+                'src/Atari2600SelfTest.cpp',
+                'src/Atari2600Trace.cpp',
+                'src/Atari2600Vector.cpp',
                 'src/M6502.cpp',
                 'src/M6502Disassembler.cpp',
                 'src/M6532.cpp',
                 'src/TIA.cpp',
+                'src/TIAObservation.cpp',
                 'src/TIASound.cpp',
+                'src/TIASoundRecorder.cpp',
+                'src/TIASoundSynthesizer.cpp',
+                'src/TIAStrobeHistogram.cpp',
             ],
             include_dirs=[
                 'src/',
@@ -6,9 +6,11 @@
 // the terms of the BSD license (see the COPYING file).
 
 #include "Atari2600.hpp"
+#include "Atari2600Simulation.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -62,6 +64,51 @@ void jigo::from_json(const json& j, Atari2600State& state) {
   }
 }
 
+/// Write the state in the compact binary format. The data starts with a
+/// header containing a magic number, the format version, and the cartridge
+/// type, followed by the state of each component.
+void jigo::to_binary(BinaryWriter& w, const Atari2600State& state) {
+  auto type = state.cartridge ? state.cartridge->getType()
+                              : Atari2600CartridgeState::Type::unknown;
+  to_binary(w, Atari2600State::binaryMagic);
+  to_binary(w, Atari2600State::binaryVersion);
+  to_binary(w, type);
+  to_binary(w, *state.cpu);
+  to_binary(w, *state.pia);
+  to_binary(w, *state.tia);
+  if (state.cartridge) {
+    state.cartridge->serialize(w);
+  }
+}
+
+/// Throws `std::invalid_argument` if the data is not a binary state of a
+/// supported version, is truncated, or is for a different cartridge type.
+void jigo::from_binary(BinaryReader& r, Atari2600State& state) {
+  uint32_t magic;
+  uint16_t version;
+  Atari2600CartridgeState::Type type;
+  from_binary(r, magic);
+  if (magic != Atari2600State::binaryMagic) {
+    throw invalid_argument("Not a Jigo2600 binary state");
+  }
+  from_binary(r, version);
+  if (version != Atari2600State::binaryVersion) {
+    throw invalid_argument("Unsupported binary state version " + to_string(version));
+  }
+  from_binary(r, type);
+  auto expectedType = state.cartridge ? state.cartridge->getType()
+                                      : Atari2600CartridgeState::Type::unknown;
+  if (type != expectedType) {
+    throw invalid_argument("Cartridge type mismatch");
+  }
+  from_binary(r, *state.cpu);
+  from_binary(r, *state.pia);
+  from_binary(r, *state.tia);
+  if (state.cartridge) {
+    state.cartridge->deserialize(r);
+  }
+}
+
 // -------------------------------------------------------------------
 // MARK: - Decode addresses
 // -------------------------------------------------------------------
@@ -122,93 +169,61 @@ bool Atari2600State::operator==(Atari2600State const& s) const {
 /// is generated, or a breakpoint is reached, depending which events occur
 /// first. Note that more than one of these criteria can be met at the same
 /// time; the function returns all reasons why it stopped.
+///
+/// With the fast CPU engine, the CPU is simulated an instruction at a time
+/// (see `M6502::step()`), so that the function stops only at instruction
+/// boundaries and may run a few cycles past `maxNumCPUCycles` or the
+/// beginning of a new frame. The bus activity is the same as with the
+/// cycle-level engine.
+///
+/// The simulation loop is specialized for the type of the cartridge when the
+/// latter is set (see `setStaticCartridgeDispatch()`).
 
 Atari2600::StoppingReason Atari2600::cycle(size_t& maxNumCPUCycles) {
-  // Handle inputs.
-  syncPorts();
-
-  // Simulate cycles.
-  StoppingReason reason;
-  auto _cpu = getCpu();
-  auto _pia = getPia();
-  auto _tia = getTia();
-  auto _cart = getCartridge();
-
-  // If no cycles should be simulated, make sure we stop immediately.
-  reason.set(StoppingReason::numCyclesReached, maxNumCPUCycles == 0);
-
-  // Loop until one of the stopping reasons is met.
-  while (!reason.any()) {
-    // Step the CPU and decode the address it places on the bus.
-    _cpu->cycle(_tia->RDY);
-    maxNumCPUCycles--;
-    auto da = DecodedAddress(_cpu->getAddressBus(), _cpu->getRW());
-
-    // Step the PIA.
-    bool oututPortsChanged =
-        _pia->cycle(da.device == DecodedAddress::PIA, _cpu->getAddressBus() & 0x200,
-                    _cpu->getRW(), _cpu->getAddressBus(), _cpu->getDataBus());
-
-    if (oututPortsChanged) {
-      syncPorts();
-    }
-
-    // Step the TIA. Remember the current frame in order to detect
-    // the beginning of a new one.
-    auto lastFrame = _tia->numFrames;
-    _tia->cycle(da.device == DecodedAddress::TIA, _cpu->getRW(), _cpu->getAddressBus(),
-                _cpu->getDataBus());
+  return (this->*cycleFunction)(maxNumCPUCycles);
+}
 
-    // Step the cartridge. The cartridge must be updated last
-    // as some rare cart types (FE banking) "sniff"
-    // the data bus to work, and the latter must be up to date.
-    if (cartridge) {
-      _cart->cycle(*this, da.device == DecodedAddress::Cartridge);
-    }
+/// Set whether to run the simulation loop specialized for the type of the
+/// cartridge (the default) or the generic one, which calls the cartridge
+/// through its virtual interface. The two are equivalent; the latter is
+/// mostly useful for benchmarking.
+void Atari2600::setStaticCartridgeDispatch(bool x) {
+  staticCartridgeDispatch = x;
+  selectCycleFunction();
+}
 
-    if (_tia->getVerbose() & false) {
-      cout << (da.Rw ? "R" : "W") << setfill('0') << setw(4) << hex
-           << (int)_cpu->getAddressBus() << " (" << setfill(' ') << setw(8) << da
-           << ") = " << setfill('0') << setw(2) << hex << (int)_cpu->getDataBus() << " "
-           << M6502::decode(_cpu->getIR()) << " T" << _cpu->getT() << std::endl;
+/// Run the simulation for `numFrames` video frames in a single call. Before
+/// the k-th frame is simulated, the inputs `inputs[k]` are applied (see
+/// `setFrameInput()`); after it is complete, the frame is copied to
+/// `screens + k * TIA::screenWidth * TIA::screenHeight`. Either array can be
+/// null to skip the corresponding step.
+///
+/// The function stops early if a breakpoint or a watchpoint is hit or if a frame does not
+/// complete within `maxNumCPUCycles` CPU cycles. On return, `numFrames`
+/// contains the number of frames that are left to simulate.
+
+Atari2600::StoppingReason Atari2600::runFrames(size_t& numFrames,
+                                               FrameInput const* inputs,
+                                               uint32_t* screens,
+                                               size_t maxNumCPUCycles) {
+  constexpr size_t screenSize = TIA::screenWidth * TIA::screenHeight;
+  StoppingReason reason;
+  for (size_t k = 0; numFrames > 0; ++k) {
+    if (inputs) {
+      setFrameInput(inputs[k]);
     }
-
-    // Check if the maximum number of CPU clocks have been simulated.
-    reason.set(StoppingReason::numCyclesReached, maxNumCPUCycles == 0);
-
-    // Check if a new frame has started.
-    if (_tia->numFrames > lastFrame) {
-      reason.set(StoppingReason::frameDone);
+    size_t numCycles = maxNumCPUCycles;
+    reason = cycle(numCycles);
+    if (!reason[StoppingReason::frameDone]) {
+      break;
     }
-
-    // Check if a breakpoint was hit.
-    if ((_cpu->getT() == 1) && _tia->RDY && breakOnNextInstruction) {
-      // T=1 means that the CPU is executing the first cycle of a
-      // new instruction. At this point, the CPU registers
-      // are already updated with the *input* to that instruction,
-      // including cpu.PCForCurrentInstruction().
-      reason.set(StoppingReason::breakpoint);
-      breakOnNextInstruction = false;
+    --numFrames;
+    if (screens) {
+      memcpy(screens + k * screenSize, getTia()->getLastScreen(),
+             screenSize * sizeof(uint32_t));
     }
-
-    if (_cpu->getT() == 0) {
-      // T=0 means that the CPU has put on the address bus the
-      // address of the next instruction opcode. Note, however,
-      // that the *previous* instruction is still finishing during this
-      // cycle, so cpu.PCForCurrentInstruction() is still the old one
-      // and registers are still not updated with the new data.
-      //
-      // The breakpoint list is scanned to check for a hit after the *next*
-      // cycle is executed.
-      uint32_t virtualAddress = da.address;
-      if (da.device == DecodedAddress::Cartridge && _cart) {
-        virtualAddress = _cart->decodeAddress(virtualAddress);
-      }
-      if (breakPoints.find(virtualAddress) != breakPoints.end()) {
-        // Clear the breakpoint if temporary.
-        clearBreakPoint(virtualAddress, true);
-        breakOnNextInstruction |= true;
-      }
+    if (reason[StoppingReason::breakpoint] || reason[StoppingReason::watchpoint]) {
+      break;
     }
   }
   return reason;
@@ -220,6 +235,8 @@ Atari2600::StoppingReason Atari2600::cycle(size_t& maxNumCPUCycles) {
 
 void Atari2600::setCartridge(shared_ptr<Atari2600Cartridge> cartridge) {
   this->cartridge = cartridge;
+  cartridgeInterface = cartridge.get();
+  selectCycleFunction();
   reset();
 }
 
@@ -260,6 +277,40 @@ Atari2600Error Atari2600::loadState(const Atari2600State& s) {
   return Atari2600Error::success;
 }
 
+/// Copy the mutable system state into `snapshot`. Contrary to `saveState()`,
+/// this does not allocate memory nor copy the cartridge ROM.
+void Atari2600::saveStateInto(Atari2600Snapshot& snapshot) const {
+  snapshot.cpu = *cpu;
+  snapshot.pia = *pia;
+  snapshot.tia = *tia;
+  if (cartridge) {
+    snapshot.cartridgeType = cartridge->getType();
+    snapshot.cartridgeSize = (uint32_t)cartridge->saveInto(snapshot.cartridge);
+    assert(snapshot.cartridgeSize <= Atari2600CartridgeState::maxSnapshotSize);
+  } else {
+    snapshot.cartridgeType = Atari2600CartridgeState::Type::unknown;
+    snapshot.cartridgeSize = 0;
+  }
+}
+
+/// Reset the system's state from a snapshot obtained from `saveStateInto()`.
+/// The snapshot must refer to a cartridge of the same type as the current one.
+Atari2600Error Atari2600::loadStateFrom(Atari2600Snapshot const& snapshot) {
+  auto type = cartridge ? cartridge->getType() : Atari2600CartridgeState::Type::unknown;
+  if (type != snapshot.cartridgeType) {
+    return Atari2600Error::cartridgeTypeMismatch;
+  }
+  if (cartridge) {
+    cartridge->loadFrom(snapshot.cartridge);
+  }
+  *getCpu() = snapshot.cpu;
+  *getPia() = snapshot.pia;
+  *getTia() = snapshot.tia;
+  // To update dependents.
+  setVideoStandard(getTia()->videoStandard);
+  return Atari2600Error::success;
+}
+
 /// Set the emulator verbosity level. The following levels are supported:
 ///
 /// - 0: supporesses all messages.
@@ -350,6 +401,21 @@ void Atari2600::setKeyboard(int num, Atari2600::Keyboard keys) {
   inputType = InputType::keyboard;
 }
 
+/// Apply a packed set of inputs. The panel is always updated; the
+/// joysticks or the paddles are updated depending on which kind of
+/// peripheral is currently connected.
+void Atari2600::setFrameInput(FrameInput const& input) {
+  panel = Panel(input.panel);
+  if (inputType == InputType::paddle) {
+    for (int num = 0; num < 4; ++num) {
+      paddles[num] = Paddle((input.paddleFires >> num) & 1, input.paddleAngles[num]);
+    }
+  } else if (inputType == InputType::joystick) {
+    joysticks[0] = Joystick(input.joysticks[0]);
+    joysticks[1] = Joystick(input.joysticks[1]);
+  }
+}
+
 void Atari2600::syncPorts() {
   auto& tia = *getTia();
   auto& pia = *getPia();
@@ -430,6 +496,18 @@ Atari2600::Atari2600()
   setVideoStandard(VideoStandard::NTSC);
   panel.Panel::super::reset();
   panel.set(Panel::colorMode);
+  breakOnNextInstruction = false;
+  watchPointHit = false;
+  debugging = false;
+  lastWatchPointHit = {};
+  fastScanline = false;
+  fastCPU = false;
+  fastWSYNC = false;
+  staticCartridgeDispatch = true;
+  traceRecorder = nullptr;
+  profiler = nullptr;
+  cartridgeInterface = nullptr;
+  selectCycleFunction();
   reset();
 }
 
@@ -474,6 +552,10 @@ uint32_t Atari2600::virtualizeAddress(uint16_t address) const {
   return virtualAddress;
 }
 
+/// Get a pointer to the RAM or ROM byte at `address`, or null if the
+/// address does not map to memory. Cartridge addresses in the banks
+/// currently mapped by the CPU are resolved by the cartridge page table;
+/// the others are decoded into cartridge regions.
 uint8_t const* Atari2600::dataForVirtualAddress(std::uint32_t address) const {
   uint8_t const* data = NULL;
   auto da = DecodedAddress(address, false);
@@ -482,6 +564,10 @@ uint8_t const* Atari2600::dataForVirtualAddress(std::uint32_t address) const {
   } else if (da.device == DecodedAddress::Cartridge) {
     auto cart = getCartridge();
     if (cart) {
+      auto const& page = cart->getPage((address >> 8) & 0xf);
+      if (page.data && page.virtualAddress == (address & ~0xffu)) {
+        return page.data + (address & 0xff);
+      }
       auto ca = cart->decodeVirtualAddress(address);
       if (ca.valid) {
         auto region = cart->getRegion(ca.regionNumber);
@@ -497,11 +583,39 @@ uint8_t* Atari2600::mutableDataForVirtualAddress(std::uint32_t address) {
   return (uint8_t*)(data);
 }
 
+/// Read the RAM or ROM byte at `virtualAddress` without simulating a bus
+/// access, and hence without side effects such as bank switching. Addresses
+/// that do not map to memory, such as the TIA and PIA registers, read as zero.
+uint8_t Atari2600::peek(uint32_t virtualAddress) const {
+  auto data = dataForVirtualAddress(virtualAddress);
+  return data ? *data : 0;
+}
+
+/// Write the RAM or ROM byte at `virtualAddress` without simulating a bus
+/// access. Writes to addresses that do not map to memory are ignored.
+void Atari2600::poke(uint32_t virtualAddress, uint8_t data) {
+  auto bytes = mutableDataForVirtualAddress(virtualAddress);
+  if (bytes) {
+    *bytes = data;
+  }
+}
+
+/// Read `size` consecutive bytes starting at `virtualAddress` (see `peek()`).
+void Atari2600::dump(uint8_t* data, uint32_t virtualAddress, size_t size) const {
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = peek(virtualAddress + (uint32_t)i);
+  }
+}
+
 map<uint32_t, Atari2600BreakPoint> const& Atari2600::getBreakPoints() {
   return breakPoints;
 }
 
-void Atari2600::setBreakPoint(uint32_t virtualAddress, bool temporary) {
+/// Set a breakpoint at the instruction at `virtualAddress`. A temporary
+/// breakpoint is cleared when hit. A persistent breakpoint stops the
+/// simulation only if `condition` holds when the instruction begins.
+void Atari2600::setBreakPoint(uint32_t virtualAddress, bool temporary,
+                              Atari2600Condition const& condition) {
   if (breakPoints.find(virtualAddress) == breakPoints.end()) {
     breakPoints[virtualAddress] = Atari2600BreakPoint();
   }
@@ -509,9 +623,15 @@ void Atari2600::setBreakPoint(uint32_t virtualAddress, bool temporary) {
   bp.virtualAddress = virtualAddress;
   if (!temporary) {
     bp.persistent = true;
+    bp.condition = condition;
   } else {
     bp.temporary = true;
   }
+  if ((virtualAddress >> 6) >= breakPointBits.size()) {
+    breakPointBits.resize((virtualAddress >> 6) + 1);
+  }
+  breakPointBits[virtualAddress >> 6] |= uint64_t(1) << (virtualAddress & 63);
+  updateDebugging();
 }
 
 void Atari2600::clearBreakPoint(uint32_t virtualAddress, bool temporary) {
@@ -520,22 +640,110 @@ void Atari2600::clearBreakPoint(uint32_t virtualAddress, bool temporary) {
     auto& bp = bpi->second;
     if (!temporary) {
       bp.persistent = false;
+      bp.condition = Atari2600Condition();
     } else {
       bp.temporary = false;
     }
     if (!bp.persistent && !bp.temporary) {
       // There are no more breakpoints at this address.
       breakPoints.erase(bpi);
+      breakPointBits[virtualAddress >> 6] &= ~(uint64_t(1) << (virtualAddress & 63));
+      updateDebugging();
     }
   }
 }
 
 void Atari2600::setBreakPointOnNextInstruction() {
   breakOnNextInstruction = true;
+  breakCondition = Atari2600Condition();
 }
 
 void Atari2600::clearBreakPointOnNextInstruction() {
   breakOnNextInstruction = false;
+  watchPointHit = false;
+}
+
+map<uint16_t, Atari2600WatchPoint> const& Atari2600::getWatchPoints() const {
+  return watchPoints;
+}
+
+/// Set a watchpoint on the reads, the writes, or both of the TIA register,
+/// PIA register, or RAM byte at `address`, including its mirrors. An access
+/// stops the simulation at the beginning of the next instruction if
+/// `condition` holds at the end of the access cycle. Throws
+/// `std::invalid_argument` if `address` is in the cartridge space.
+void Atari2600::setWatchPoint(uint16_t address, bool read, bool write,
+                              Atari2600Condition const& condition) {
+  if (address & 0x1000) {
+    throw invalid_argument("Watchpoints cannot be set in the cartridge space");
+  }
+  for (bool w : {false, true}) {
+    if (!(w ? write : read)) continue;
+    auto canonical = canonicalizeAddress(address, !w);
+    auto key = watchKey(canonical, w);
+    watchPoints[key] = Atari2600WatchPoint{canonical, w, condition};
+    watchPointBits.set(key);
+  }
+  updateDebugging();
+}
+
+void Atari2600::clearWatchPoint(uint16_t address, bool read, bool write) {
+  for (bool w : {false, true}) {
+    if (!(w ? write : read)) continue;
+    auto key = watchKey(canonicalizeAddress(address, !w), w);
+    watchPoints.erase(key);
+    watchPointBits.reset(key);
+  }
+  updateDebugging();
+}
+
+/// Map the bus address of a TIA register, a PIA register, or a RAM byte to
+/// a canonical address, the same for all its mirrors. TIA registers map to
+/// $00-$3F, RAM to $80-$FF, and PIA registers to $280-$29F. Cartridge
+/// addresses are returned unchanged.
+uint16_t Atari2600::canonicalizeAddress(uint16_t address, bool RW) {
+  if (address & 0x1000) {
+    return address;
+  } else if (!(address & 0x80)) {
+    return address & (RW ? 0x0f : 0x3f);
+  } else if (!(address & 0x200)) {
+    return 0x80 | (address & 0x7f);
+  } else {
+    auto reg = static_cast<uint16_t>(M6532::decodeAddress(true, RW, address));
+    return 0x280 | (reg & 0x1f);
+  }
+}
+
+/// Evaluate `condition` for the current state, with the data operand equal
+/// to `data`.
+bool Atari2600::evaluate(Atari2600Condition const& condition, uint8_t data) const {
+  using Operand = Atari2600Condition::Operand;
+  using Comparison = Atari2600Condition::Comparison;
+  uint8_t x = 0;
+  switch (condition.operand) {
+  case Operand::always: return true;
+  case Operand::A: x = getCpu()->getA(); break;
+  case Operand::X: x = getCpu()->getX(); break;
+  case Operand::Y: x = getCpu()->getY(); break;
+  case Operand::S: x = getCpu()->getS(); break;
+  case Operand::P: x = getCpu()->getP(); break;
+  case Operand::memory: x = peek(condition.address); break;
+  case Operand::data: x = data; break;
+  }
+  x &= condition.mask;
+  switch (condition.comparison) {
+  case Comparison::equal: return x == condition.value;
+  case Comparison::notEqual: return x != condition.value;
+  case Comparison::less: return x < condition.value;
+  case Comparison::lessOrEqual: return x <= condition.value;
+  case Comparison::greater: return x > condition.value;
+  case Comparison::greaterOrEqual: return x >= condition.value;
+  }
+  return false;
+}
+
+void Atari2600::updateDebugging() {
+  debugging = !breakPoints.empty() || !watchPoints.empty();
 }
 
 std::ostream& Atari2600::printInstruction(std::ostream& os,
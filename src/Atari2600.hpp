@@ -14,12 +14,15 @@
 #include "json.hpp"
 
 #include <array>
+#include <bitset>
 #include <cstdint>
 #include <map>
 #include <vector>
 
 namespace jigo {
 class Atari2600;
+class Atari2600Profiler;
+class Atari2600TraceRecorder;
 enum class Atari2600Error : int { success, cartridgeTypeMismatch };
 
 // -----------------------------------------------------------------
@@ -44,11 +47,18 @@ public:
   // Lifecycle.
   virtual void serialize(nlohmann::json& j) const = 0;
   virtual void deserialize(const nlohmann::json& j) = 0;
+  virtual void serialize(BinaryWriter& w) const = 0;
+  virtual void deserialize(BinaryReader& r) = 0;
   virtual Atari2600Error load(Atari2600CartridgeState const&) = 0;
   virtual std::unique_ptr<Atari2600CartridgeState> save() const = 0;
   virtual std::unique_ptr<Atari2600CartridgeState> makeAlike() const = 0;
   virtual bool operator==(Atari2600CartridgeState const&) const = 0;
   virtual ~Atari2600CartridgeState() = default;
+
+  // Snapshot.
+  static constexpr size_t maxSnapshotSize = 256;
+  virtual size_t saveInto(std::uint8_t* data) const = 0;
+  virtual size_t loadFrom(std::uint8_t const* data) = 0;
 };
 
 class Atari2600Cartridge : public virtual Atari2600CartridgeState {
@@ -60,8 +70,21 @@ public:
   virtual int getVerbosity() const = 0;
 
   // Lifecycle.
+  Atari2600Cartridge() = default;
+  Atari2600Cartridge(Atari2600Cartridge const&) = delete;
+  Atari2600Cartridge& operator=(Atari2600Cartridge const&) = delete;
   virtual ~Atari2600Cartridge() = default;
 
+  // Memory map.
+  static constexpr int pageSize = 256;
+  static constexpr int numPages = 16;
+  struct Page {
+    std::uint8_t const* data;     /// Bytes read by the CPU, or null.
+    std::uint32_t virtualAddress; /// Virtual address of the first byte.
+    bool direct;                  /// Whether accesses have no side effects.
+  };
+  Page const& getPage(int number) const { return pages[number]; }
+
   // Inspect.
   struct Region {
     std::string name;
@@ -82,6 +105,10 @@ public:
   virtual int getNumBanks() const = 0;
   virtual int getNumRegions() const = 0;
   virtual Region getRegion(int number) const = 0;
+
+protected:
+  virtual void updatePages() = 0;
+  std::array<Page, numPages> pages{};
 };
 
 std::shared_ptr<Atari2600Cartridge>
@@ -96,10 +123,48 @@ makeCartridgeFromBytes(const std::vector<char>& data,
 // MARK: - System
 // -----------------------------------------------------------------
 
+/// A predicate on the state of the machine. The operand, masked by `mask`,
+/// is compared to `value`. The memory operand is the byte at the virtual
+/// address `address` (see `Atari2600::peek()`); the data operand is the byte
+/// on the data bus during a watched access.
+struct Atari2600Condition {
+  enum class Operand : std::uint8_t { always, A, X, Y, S, P, memory, data };
+  enum class Comparison : std::uint8_t {
+    equal,
+    notEqual,
+    less,
+    lessOrEqual,
+    greater,
+    greaterOrEqual
+  };
+  Operand operand{Operand::always};
+  Comparison comparison{Comparison::equal};
+  std::uint8_t mask{0xff};
+  std::uint8_t value{0};
+  std::uint32_t address{0};
+};
+
 struct Atari2600BreakPoint {
   std::uint32_t virtualAddress;
   bool persistent;
   bool temporary;
+  Atari2600Condition condition; /// Condition of the persistent breakpoint.
+};
+
+/// A watchpoint on the reads or the writes of a TIA register, a PIA
+/// register, or a RAM byte. The address is canonical, with the mirrors
+/// folded (see `Atari2600::canonicalizeAddress()`).
+struct Atari2600WatchPoint {
+  std::uint16_t address;
+  bool write;
+  Atari2600Condition condition;
+};
+
+struct Atari2600WatchPointHit {
+  std::uint64_t cycle;   /// CPU cycle of the access.
+  std::uint16_t address; /// Address on the bus.
+  std::uint8_t data;     /// Data on the bus.
+  bool write;
 };
 
 struct Atari2600State {
@@ -113,6 +178,10 @@ struct Atari2600State {
   // Insepct.
   bool operator==(Atari2600State const&) const;
 
+  // Binary format.
+  static constexpr std::uint32_t binaryMagic = 0x5336324a; // "J26S"
+  static constexpr std::uint16_t binaryVersion = 3;
+
   // Data.
   std::shared_ptr<M6502State> cpu;
   std::shared_ptr<M6532State> pia;
@@ -120,11 +189,23 @@ struct Atari2600State {
   std::shared_ptr<Atari2600CartridgeState> cartridge;
 };
 
+/// A flat copy of the mutable state of the system. Contrary to
+/// `Atari2600State`, a snapshot owns no heap memory and excludes the
+/// cartridge ROM, so that it can be saved and restored without allocations.
+struct Atari2600Snapshot {
+  M6502State cpu;
+  M6532State pia;
+  TIAState tia;
+  Atari2600CartridgeState::Type cartridgeType;
+  std::uint32_t cartridgeSize;
+  std::uint8_t cartridge[Atari2600CartridgeState::maxSnapshotSize];
+};
+
 class Atari2600 : public Atari2600State {
 public:
   typedef jigo::TIAState::VideoStandard VideoStandard;
   struct StoppingReason : std::bitset<32> {
-    enum { frameDone = 0, breakpoint, numCyclesReached };
+    enum { frameDone = 0, breakpoint, numCyclesReached, watchpoint };
   };
 
   struct DecodedAddress {
@@ -148,14 +229,14 @@ public:
 
   // Manipulate the cartridge.
   void setCartridge(std::shared_ptr<Atari2600Cartridge> cartridge);
-  Atari2600Cartridge* getCartridge() const {
-    return dynamic_cast<Atari2600Cartridge*>(cartridge.get());
-  }
+  Atari2600Cartridge* getCartridge() const { return cartridgeInterface; }
 
   // Manipulate the state.
   Atari2600Error loadState(const Atari2600State& state);
   std::shared_ptr<Atari2600State> saveState() const;
   std::shared_ptr<Atari2600State> makeState() const;
+  void saveStateInto(Atari2600Snapshot& snapshot) const;
+  Atari2600Error loadStateFrom(Atari2600Snapshot const& snapshot);
 
   // Debug.
   std::uint8_t peek(std::uint32_t virtualAddress) const;
@@ -168,14 +249,27 @@ public:
       std::uint32_t virtualAddress); // todo: think if we really want this
 
   std::map<std::uint32_t, Atari2600BreakPoint> const& getBreakPoints();
-  void setBreakPoint(std::uint32_t virtualAddress, bool temporary = false);
+  void setBreakPoint(std::uint32_t virtualAddress, bool temporary = false,
+                     Atari2600Condition const& condition = {});
   void clearBreakPoint(std::uint32_t virtualAddress, bool temporary = false);
   void setBreakPointOnNextInstruction();
   void clearBreakPointOnNextInstruction();
+  std::map<std::uint16_t, Atari2600WatchPoint> const& getWatchPoints() const;
+  void setWatchPoint(std::uint16_t address, bool read, bool write,
+                     Atari2600Condition const& condition = {});
+  void clearWatchPoint(std::uint16_t address, bool read, bool write);
+  Atari2600WatchPointHit const& getLastWatchPointHit() const { return lastWatchPointHit; }
+  bool evaluate(Atari2600Condition const& condition, std::uint8_t data = 0) const;
+  static std::uint16_t canonicalizeAddress(std::uint16_t address, bool RW);
   static std::ostream& printInstruction(std::ostream& os, M6502::Instruction const& ins);
 
   // Run the simulation.
+  struct FrameInput;
+  static constexpr size_t maxNumCPUCyclesPerFrame = 2 * 312 * 76;
   StoppingReason cycle(size_t& maxNumCPUCycles);
+  StoppingReason runFrames(size_t& numFrames, FrameInput const* inputs = nullptr,
+                           std::uint32_t* screens = nullptr,
+                           size_t maxNumCPUCycles = maxNumCPUCyclesPerFrame);
   long long getColorCycleNumber() const;
   long long getFrameNumber() const;
   float getColorClockRate() const;
@@ -183,6 +277,18 @@ public:
   // Configure the machine.
   void setVideoStandard(VideoStandard standard);
   VideoStandard getVideoStandard() const;
+  void setFastScanline(bool x) { fastScanline = x; }
+  bool getFastScanline() const { return fastScanline; }
+  void setFastCPU(bool x) { fastCPU = x; }
+  bool getFastCPU() const { return fastCPU; }
+  void setFastWSYNC(bool x) { fastWSYNC = x; }
+  bool getFastWSYNC() const { return fastWSYNC; }
+  void setStaticCartridgeDispatch(bool x);
+  bool getStaticCartridgeDispatch() const { return staticCartridgeDispatch; }
+  void setTraceRecorder(Atari2600TraceRecorder* x) { traceRecorder = x; }
+  Atari2600TraceRecorder* getTraceRecorder() const { return traceRecorder; }
+  void setProfiler(Atari2600Profiler* x) { profiler = x; }
+  Atari2600Profiler* getProfiler() const { return profiler; }
 
   // Panel and perpipherals.
   struct Panel : std::bitset<5> {
@@ -206,11 +312,20 @@ public:
 
   using Keyboard = std::bitset<12>;
 
+  /// Packed inputs applied at the beginning of a frame by `runFrames()`.
+  struct FrameInput {
+    std::uint8_t panel;        /// Panel switches (`Panel` bits).
+    std::uint8_t joysticks[2]; /// Joystick switches (`Joystick` bits).
+    std::uint8_t paddleFires;  /// Paddle fire buttons (bit k for paddle k).
+    float paddleAngles[4];     /// Paddle angles.
+  };
+
   void setPanel(Panel panel);
   void setJoystick(int num, Joystick joystick);
   void setPaddle(int num, Paddle paddle);
   void setKeyboard(int num, Keyboard keys);
   void setVerbosity(int verbosity);
+  void setFrameInput(FrameInput const& input);
 
   Panel getPanel() const;
 
@@ -224,16 +339,49 @@ protected:
 
   void syncPorts();
 
-  // Transient.
-  float clockRate;
+  // Simulation loop.
+  using CycleFunction = StoppingReason (Atari2600::*)(size_t&);
+  template <class Cartridge> struct CPUBus;
+  template <class Cartridge> StoppingReason cycleWithCartridge(size_t& maxNumCPUCycles);
+  void selectCycleFunction();
+  CycleFunction cycleFunction;
+  Atari2600Cartridge* cartridgeInterface;
+  void* concreteCartridge;
+
+  // Debugger. The breakpoints and watchpoints are mirrored by bitmaps, over
+  // the virtual addresses and the watch keys respectively (see
+  // `watchKey()`), so that the simulation loop only searches the maps on a
+  // hit; `debugging` is set if there is any.
+  static std::uint16_t watchKey(std::uint16_t canonicalAddress, bool write) {
+    return static_cast<std::uint16_t>((canonicalAddress << 1) | write);
+  }
+  void updateDebugging();
   std::map<std::uint32_t, Atari2600BreakPoint> breakPoints;
+  std::map<std::uint16_t, Atari2600WatchPoint> watchPoints;
+  std::vector<std::uint64_t> breakPointBits;
+  std::bitset<0x800> watchPointBits;
+  Atari2600Condition breakCondition;
+  Atari2600WatchPointHit lastWatchPointHit;
   bool breakOnNextInstruction;
+  bool watchPointHit;
+  bool debugging;
+
+  // Transient.
+  float clockRate;
+  bool fastScanline;
+  bool fastCPU;
+  bool fastWSYNC;
+  bool staticCartridgeDispatch;
+  Atari2600TraceRecorder* traceRecorder;
+  Atari2600Profiler* profiler;
 };
 
 void to_json(nlohmann::json& j, const jigo::Atari2600Cartridge::Type& type);
 void from_json(const nlohmann::json& j, jigo::Atari2600Cartridge::Type& type);
 void to_json(nlohmann::json& j, const jigo::Atari2600State& state);
 void from_json(const nlohmann::json& j, jigo::Atari2600State& state);
+void to_binary(BinaryWriter& w, const jigo::Atari2600State& state);
+void from_binary(BinaryReader& r, jigo::Atari2600State& state);
 void to_json(nlohmann::json& j, const jigo::Atari2600::VideoStandard& standard);
 void from_json(const nlohmann::json& j, jigo::Atari2600::VideoStandard& standard);
 } // namespace jigo
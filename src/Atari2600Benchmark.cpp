@@ -0,0 +1,646 @@
+// Atari2600Benchmark.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "Atari2600Benchmark.hpp"
+#include "Atari2600.hpp"
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+using namespace std;
+using namespace jigo;
+using json = nlohmann::json;
+
+// -------------------------------------------------------------------
+// MARK: - Synthetic programs
+// -------------------------------------------------------------------
+
+// The benchmarks run synthetic programs rather than game ROMs, which are
+// not distributed with the emulator. The full-system kernels follow the
+// structure of a typical homebrew game (VSYNC, a timed VBLANK, 192 lines
+// of playfield and sprite updates synchronized with WSYNC, and overscan).
+
+/// Opcodes used by the programs, suffixed by their addressing mode.
+enum : uint8_t {
+  ADC_imm = 0x69, AND_imm = 0x29, ASL_acc = 0x0a, BCC = 0x90,     BIT_zp = 0x24,
+  BNE = 0xd0,     CLC = 0x18,     CLD = 0xd8,     CMP_imm = 0xc9, DEC_abs = 0xce,
+  DEX = 0xca,     DEY = 0x88,     EOR_imm = 0x49, EOR_zp = 0x45,  INC_zp = 0xe6,
+  INX = 0xe8,     JMP_abs = 0x4c, JSR_abs = 0x20, LDA_abs = 0xad, LDA_absx = 0xbd,
+  LDA_absy = 0xb9, LDA_imm = 0xa9, LDA_indy = 0xb1, LDA_zp = 0xa5, LDX_imm = 0xa2,
+  LDY_imm = 0xa0, NOP = 0xea,     ORA_imm = 0x09, PHA = 0x48,     PLA = 0x68,
+  ROR_acc = 0x6a, RTS = 0x60,     SEI = 0x78,     STA_abs = 0x8d, STA_absx = 0x9d,
+  STA_indy = 0x91, STA_zp = 0x85, STA_zpx = 0x95, TAX = 0xaa,     TXA = 0x8a,
+  TXS = 0x9a,     TYA = 0x98
+};
+
+/// A minimal 6502 code emitter.
+struct Program {
+  explicit Program(uint16_t origin) : origin(origin) {}
+  uint16_t here() const { return static_cast<uint16_t>(origin + bytes.size()); }
+  void op(uint8_t opcode) { bytes.push_back(opcode); }
+  void op(uint8_t opcode, uint8_t x) { bytes.insert(bytes.end(), {opcode, x}); }
+  void op16(uint8_t opcode, uint16_t x) {
+    bytes.insert(bytes.end(),
+                 {opcode, static_cast<uint8_t>(x), static_cast<uint8_t>(x >> 8)});
+  }
+  void branch(uint8_t opcode, uint16_t target) {
+    op(opcode, static_cast<uint8_t>(target - (here() + 2)));
+  }
+  uint16_t origin;
+  vector<uint8_t> bytes;
+};
+
+/// Make a CPU instruction mix looping forever. The programs are located at
+/// 0x1000 and use the zero page and the pages 0x02-0x04 as data.
+static Program makeInstructionMix(string const& mix) {
+  Program p(0x1000);
+  p.op(LDX_imm, 0xff);
+  p.op(TXS);
+  p.op(LDA_imm, 0x00);
+  p.op(STA_zp, 0x80);
+  p.op(LDA_imm, 0x02);
+  p.op(STA_zp, 0x81);
+  auto loop = p.here();
+  if (mix == "alu") {
+    p.op(LDA_imm, 0x35);
+    p.op(ADC_imm, 0x17);
+    p.op(EOR_imm, 0x5a);
+    p.op(AND_imm, 0xf3);
+    p.op(ORA_imm, 0x08);
+    p.op(CMP_imm, 0x40);
+    p.op(ASL_acc);
+    p.op(ROR_acc);
+    p.op(TAX);
+    p.op(INX);
+    p.op(TXA);
+  } else if (mix == "memory") {
+    p.op(LDA_zp, 0x82);
+    p.op(STA_zpx, 0x90);
+    p.op16(LDA_absy, 0x0300);
+    p.op16(STA_abs, 0x0400);
+    p.op(INC_zp, 0x83);
+    p.op(LDA_indy, 0x80);
+    p.op(STA_indy, 0x80);
+    p.op16(DEC_abs, 0x0401);
+    p.op(BIT_zp, 0x84);
+    p.op(INX);
+  } else {
+    p.op16(JSR_abs, 0x1800);
+    p.op(CLC);
+    p.op(BCC, 0x01); // Skip the NOP.
+    p.op(NOP);
+    p.op(LDX_imm, 0x03);
+    auto inner = p.here();
+    p.op(DEX);
+    p.branch(BNE, inner);
+    p.op(PHA);
+    p.op(PLA);
+  }
+  p.op(DEY);
+  p.branch(BNE, loop);
+  p.op16(JMP_abs, loop);
+  if (mix == "control") {
+    p.bytes.resize(0x1800 - p.origin, NOP);
+    p.op(RTS);
+  }
+  return p;
+}
+
+/// Make the ROM of a game kernel. Banked ROMs contain the same code in
+/// each bank and switch to the next bank at the end of every frame. If
+/// `superchip` is true, the kernel also copies a line of the cartridge RAM
+/// at each scanline. The kernel stores the fire button of the left
+/// joystick and the joystick directions (INPT4 and SWCHA) at $81 and $82
+/// at each frame.
+vector<char> jigo::makeBenchmarkKernelROM(size_t romSize, int minBankStrobe,
+                                          bool superchip) {
+  int const numBanks = max(static_cast<int>(romSize / 4096), 1);
+  vector<char> rom(romSize, 0);
+  for (int bank = 0; bank < numBanks; ++bank) {
+    // Skip the first pages, which are occupied by the RAM of superchip
+    // cartridges.
+    Program p(0xf200);
+    auto start = p.here();
+    p.op(SEI);
+    p.op(CLD);
+    p.op(LDX_imm, 0xff);
+    p.op(TXS);
+    p.op(LDA_imm, 0x00);
+    auto clear = p.here();
+    p.op(STA_zpx, 0x00);
+    p.op(DEX);
+    p.branch(BNE, clear);
+
+    // Vertical sync and blank. The VBLANK duration is timed by the PIA.
+    auto frame = p.here();
+    p.op(LDA_imm, 0x02);
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(STA_zp, TIA::VSYNC);
+    p.op(STA_zp, TIA::VBLANK);
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(LDA_imm, 0x00);
+    p.op(STA_zp, TIA::VSYNC);
+    p.op(LDA_imm, 43);
+    p.op16(STA_abs, 0x0296); // TIM64T
+    p.op(INC_zp, 0x80);
+    p.op(LDA_zp, 0x80);
+    p.op(STA_zp, TIA::AUDF0);
+    p.op(LDA_imm, 0x04);
+    p.op(STA_zp, TIA::AUDC0);
+    p.op(LDA_imm, 0x06);
+    p.op(STA_zp, TIA::AUDV0);
+    p.op(LDA_zp, TIA::INPT4 & 0x0f);
+    p.op(STA_zp, 0x81);
+    p.op16(LDA_abs, 0x0280); // SWCHA
+    p.op(STA_zp, 0x82);
+    p.op(LDA_zp, TIA::CXP0FB & 0x0f);
+    p.op(STA_zp, TIA::CXCLR);
+    p.op(LDA_zp, 0x80);
+    p.op(AND_imm, 0xf0);
+    p.op(STA_zp, TIA::HMP0);
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(STA_zp, TIA::HMOVE);
+    auto wait = p.here();
+    p.op16(LDA_abs, 0x0284); // INTIM
+    p.branch(BNE, wait);
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(STA_zp, TIA::VBLANK);
+
+    // Visible lines.
+    auto table = static_cast<uint16_t>(0xf800);
+    p.op(LDY_imm, 192);
+    auto line = p.here();
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(TYA);
+    p.op(EOR_zp, 0x80);
+    p.op(STA_zp, TIA::COLUBK);
+    p.op(STA_zp, TIA::PF1);
+    p.op16(LDA_absy, table);
+    p.op(STA_zp, TIA::GRP0);
+    p.op(STA_zp, TIA::PF2);
+    p.op(TYA);
+    p.op(AND_imm, 0x02);
+    p.op(STA_zp, TIA::ENAM0);
+    if (superchip) {
+      p.op(TYA);
+      p.op(AND_imm, 0x7f);
+      p.op(TAX);
+      p.op16(LDA_absx, 0xf080);
+      p.op(ADC_imm, 0x01);
+      p.op16(STA_absx, 0xf000);
+    }
+    p.op(DEY);
+    p.branch(BNE, line);
+
+    // Overscan.
+    p.op(LDA_imm, 0x02);
+    p.op(STA_zp, TIA::VBLANK);
+    p.op(LDX_imm, 30);
+    auto overscan = p.here();
+    p.op(STA_zp, TIA::WSYNC);
+    p.op(DEX);
+    p.branch(BNE, overscan);
+    if (numBanks > 1) {
+      int next = (bank + 1) % numBanks;
+      p.op16(LDA_abs, static_cast<uint16_t>(0xf000 + minBankStrobe + next));
+    }
+    p.op16(JMP_abs, frame);
+
+    // Data and vectors.
+    auto bytes = rom.begin() + bank * 4096;
+    copy(p.bytes.begin(), p.bytes.end(), bytes + (p.origin & 0xfff));
+    for (int k = 0; k < 256; ++k) {
+      bytes[(table & 0xfff) + k] = static_cast<char>(k * 37);
+    }
+    size_t const vectors = min(romSize, static_cast<size_t>(4096)) - 4;
+    for (int k = 0; k < 4; k += 2) {
+      bytes[vectors + k] = static_cast<char>(start & 0xff);
+      bytes[vectors + k + 1] = static_cast<char>(start >> 8);
+    }
+  }
+  return rom;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Cases
+// -------------------------------------------------------------------
+
+using Batch = function<void(Atari2600BenchmarkResult&)>;
+
+struct Case {
+  string name;
+  function<Batch()> setup; /// Prepare the case and return its timed batch.
+};
+
+/// A flat 64K RAM bus for the CPU alone.
+struct FlatBus final : M6502Bus {
+  void cycle(M6502& cpu) override {
+    if (cpu.getRW()) {
+      cpu.setDataBus(memory[cpu.getAddressBus()]);
+    } else {
+      memory[cpu.getAddressBus()] = cpu.getDataBus();
+    }
+  }
+  bool isReady() const override { return true; }
+  array<uint8_t, 0x10000> memory{};
+};
+
+static Case makeCPUCase(string const& mix, bool step) {
+  auto name = string(step ? "M6502.step/" : "M6502.cycle/") + mix;
+  return {name, [=]() -> Batch {
+            auto cpu = make_shared<M6502>();
+            auto bus = make_shared<FlatBus>();
+            auto program = makeInstructionMix(mix);
+            copy(program.bytes.begin(), program.bytes.end(),
+                 bus->memory.begin() + program.origin);
+            bus->memory[0xfffc] = program.origin & 0xff;
+            bus->memory[0xfffd] = program.origin >> 8;
+            do {
+              cpu->cycle(true);
+              bus->cycle(*cpu);
+            } while (cpu->getNumCycles() < 16 || !cpu->isAtInstructionBoundary());
+            return [=](Atari2600BenchmarkResult& r) {
+              size_t const n = 1 << 16;
+              auto begin = cpu->getNumCycles();
+              if (step) {
+                while (cpu->getNumCycles() - begin < n) {
+                  cpu->step(*bus);
+                }
+              } else {
+                for (size_t k = 0; k < n; ++k) {
+                  cpu->cycle(true);
+                  bus->cycle(*cpu);
+                }
+              }
+              r.numCycles += cpu->getNumCycles() - begin;
+            };
+          }};
+}
+
+/// A write to a TIA register at a CPU cycle of the frame.
+struct TIAWrite {
+  int cycle;
+  TIA::Register reg;
+  uint8_t value;
+};
+
+/// Make the register writes of a frame of a typical kernel, without the
+/// WSYNC stalls.
+static vector<TIAWrite> makeTIAKernel() {
+  vector<TIAWrite> writes;
+  auto put = [&](int line, int cycle, TIA::Register reg, int value) {
+    writes.push_back({76 * line + cycle, reg, static_cast<uint8_t>(value)});
+  };
+  put(0, 0, TIA::VSYNC, 2);
+  put(0, 3, TIA::VBLANK, 2);
+  put(3, 0, TIA::VSYNC, 0);
+  put(10, 0, TIA::AUDF0, 7);
+  put(10, 3, TIA::AUDC0, 4);
+  put(10, 6, TIA::AUDV0, 6);
+  put(20, 30, TIA::RESP0, 0);
+  put(21, 0, TIA::HMP0, 0x10);
+  put(22, 0, TIA::HMOVE, 0);
+  put(40, 0, TIA::VBLANK, 0);
+  for (int line = 40; line < 232; ++line) {
+    put(line, 3, TIA::COLUBK, line);
+    put(line, 8, TIA::PF0, line << 4);
+    put(line, 11, TIA::PF1, line * 3);
+    put(line, 14, TIA::PF2, line * 5);
+    put(line, 18, TIA::GRP0, line * 7);
+    put(line, 21, TIA::GRP1, line * 11);
+    put(line, 24, TIA::COLUP0, line * 2);
+    put(line, 28, TIA::ENAM0, line & 2);
+    put(line, 40, TIA::PF1, line * 13);
+    put(line, 44, TIA::PF2, line * 17);
+  }
+  put(232, 0, TIA::VBLANK, 2);
+  put(232, 3, TIA::CXCLR, 0);
+  return writes;
+}
+
+static Case makeTIACase(string const& name, TIA::RenderMode mode, bool advance) {
+  return {name, [=]() -> Batch {
+            auto tia = make_shared<TIA>();
+            auto writes = make_shared<vector<TIAWrite>>(makeTIAKernel());
+            tia->setRenderMode(mode);
+            return [=](Atari2600BenchmarkResult& r) {
+              int const numCycles = 262 * 76;
+              auto numFrames = tia->numFrames;
+              uint8_t data = 0;
+              int cycle = 0;
+              for (auto const& w : *writes) {
+                if (advance) {
+                  tia->advance(w.cycle - cycle);
+                } else {
+                  for (; cycle < w.cycle; ++cycle) {
+                    tia->cycle(false, true, 0x1000, data);
+                  }
+                }
+                data = w.value;
+                tia->cycle(true, false, w.reg, data);
+                cycle = w.cycle + 1;
+              }
+              if (advance) {
+                tia->advance(numCycles - cycle);
+              } else {
+                for (; cycle < numCycles; ++cycle) {
+                  tia->cycle(false, true, 0x1000, data);
+                }
+              }
+              r.numCycles += numCycles;
+              r.numFrames += tia->numFrames - numFrames;
+            };
+          }};
+}
+
+/// Simulate scanlines of PIA accesses: a RAM write, a RAM read, a timer
+/// read, and a read of the interrupt flags or, every 64 lines, a timer write.
+static Case makePIACase(bool advance) {
+  auto name = string(advance ? "M6532.advance" : "M6532.cycle");
+  return {name, [=]() -> Batch {
+            auto pia = make_shared<M6532>();
+            return [=](Atari2600BenchmarkResult& r) {
+              uint8_t data = 0;
+              for (int line = 0; line < 262; ++line) {
+                int const accesses[] = {0, 10, 20, 30};
+                int cycle = 0;
+                for (int a = 0; a < 4; ++a) {
+                  if (advance) {
+                    pia->advance(accesses[a] - cycle);
+                  } else {
+                    for (; cycle < accesses[a]; ++cycle) {
+                      pia->cycle(false, false, true, 0x1000, data);
+                    }
+                  }
+                  switch (a) {
+                  case 0:
+                    data = static_cast<uint8_t>(line);
+                    pia->cycle(true, false, false, 0x80 | (line & 0x7f), data);
+                    break;
+                  case 1:
+                    pia->cycle(true, false, true, 0x80 | (line & 0x7f), data);
+                    break;
+                  case 2:
+                    pia->cycle(true, true, true, 0x284, data);
+                    break;
+                  default:
+                    if (line % 64 == 0) {
+                      data = 43;
+                      pia->cycle(true, true, false, 0x296, data);
+                    } else {
+                      pia->cycle(true, true, true, 0x285, data);
+                    }
+                    break;
+                  }
+                  cycle = accesses[a] + 1;
+                }
+                if (advance) {
+                  pia->advance(76 - cycle);
+                } else {
+                  for (; cycle < 76; ++cycle) {
+                    pia->cycle(false, false, true, 0x1000, data);
+                  }
+                }
+              }
+              r.numCycles += 262 * 76;
+            };
+          }};
+}
+
+struct CartridgeFormat {
+  char const* name;
+  Atari2600Cartridge::Type type;
+  size_t size;
+  int minBankStrobe;
+};
+
+static CartridgeFormat const cartridgeFormats[] = {
+    {"S2K", Atari2600Cartridge::Type::S2K, 2048, 0},
+    {"S4K", Atari2600Cartridge::Type::S4K, 4096, 0},
+    {"S8K", Atari2600Cartridge::Type::S8K, 8192, 0xff8},
+    {"S12K", Atari2600Cartridge::Type::S12K, 12288, 0xff8},
+    {"S16K", Atari2600Cartridge::Type::S16K, 16384, 0xff6},
+    {"S32K", Atari2600Cartridge::Type::S32K, 32768, 0xff4},
+    {"S2K128R", Atari2600Cartridge::Type::S2K128R, 2048, 0},
+    {"S4K128R", Atari2600Cartridge::Type::S4K128R, 4096, 0},
+    {"S8K128R", Atari2600Cartridge::Type::S8K128R, 8192, 0xff8},
+    {"S12K128R", Atari2600Cartridge::Type::S12K128R, 12288, 0xff8},
+    {"S16K128R", Atari2600Cartridge::Type::S16K128R, 16384, 0xff6},
+    {"S32K128R", Atari2600Cartridge::Type::S32K128R, 32768, 0xff4},
+    {"E0", Atari2600Cartridge::Type::E0, 8192, 0},
+    {"FE", Atari2600Cartridge::Type::FE, 8192, 0},
+    {"F0", Atari2600Cartridge::Type::F0, 65536, 0},
+};
+
+/// Step a cartridge on pseudo-random bus reads, half of which select it.
+/// This occasionally hits the bank-switching hotspots.
+static Case makeCartridgeCase(CartridgeFormat const& format) {
+  return {string("Cartridge.cycle/") + format.name, [=]() -> Batch {
+            vector<char> bytes(format.size);
+            for (size_t k = 0; k < bytes.size(); ++k) {
+              bytes[k] = static_cast<char>(k * 13);
+            }
+            auto atari = make_shared<Atari2600>();
+            atari->setCartridge(makeCartridgeFromBytes(bytes, format.type));
+            auto cpu = atari->getCpu();
+            cpu->cycle(true); // Start the reset sequence, which reads.
+            auto seed = make_shared<uint32_t>(1);
+            return [=](Atari2600BenchmarkResult& r) {
+              size_t const n = 1 << 16;
+              auto cart = atari->getCartridge();
+              uint32_t x = *seed;
+              for (size_t k = 0; k < n; ++k) {
+                x = x * 1664525u + 1013904223u;
+                auto address = static_cast<uint16_t>(x >> 19);
+                cpu->setAddressBus(address);
+                cart->cycle(*atari, address & 0x1000);
+              }
+              *seed = x;
+              r.numCycles += n;
+            };
+          }};
+}
+
+static shared_ptr<Atari2600> makeKernelMachine(vector<char> const& rom,
+                                               Atari2600Cartridge::Type type) {
+  auto atari = make_shared<Atari2600>();
+  atari->setCartridge(makeCartridgeFromBytes(rom, type));
+  return atari;
+}
+
+/// Time an operation on the state of a machine that ran a few frames.
+static Case makeStateCase(
+    string const& name, function<function<void()>(shared_ptr<Atari2600>)> makeOperation) {
+  return {name, [=]() -> Batch {
+            auto atari = makeKernelMachine(makeBenchmarkKernelROM(4096, 0, false),
+                                           Atari2600Cartridge::Type::S4K);
+            size_t numFrames = 10;
+            atari->runFrames(numFrames);
+            auto operation = makeOperation(atari);
+            return [=](Atari2600BenchmarkResult& r) {
+              size_t const n = 64;
+              for (size_t k = 0; k < n; ++k) {
+                operation();
+              }
+              r.numOperations += n;
+            };
+          }};
+}
+
+struct KernelROM {
+  char const* name;
+  Atari2600Cartridge::Type type;
+  size_t size;
+  int minBankStrobe;
+  bool superchip;
+};
+
+static KernelROM const kernelROMs[] = {
+    {"playfield4K", Atari2600Cartridge::Type::S4K, 4096, 0, false},
+    {"bankswitch8K", Atari2600Cartridge::Type::S8K, 8192, 0xff8, false},
+    {"superchip16K", Atari2600Cartridge::Type::S16K128R, 16384, 0xff6, true},
+};
+
+static Case makeSystemCase(KernelROM const& kernel, bool fast) {
+  return {string("Atari2600.runFrames/") + kernel.name + (fast ? "/fast" : "/exact"),
+          [=]() -> Batch {
+            auto atari = makeKernelMachine(
+                makeBenchmarkKernelROM(kernel.size, kernel.minBankStrobe,
+                                       kernel.superchip),
+                kernel.type);
+            atari->setFastScanline(fast);
+            atari->setFastCPU(fast);
+            atari->setFastWSYNC(fast);
+            atari->setStaticCartridgeDispatch(fast);
+            return [=](Atari2600BenchmarkResult& r) {
+              size_t const n = 10;
+              size_t numFrames = n;
+              auto numCycles = atari->getCpu()->getNumCycles();
+              atari->runFrames(numFrames);
+              r.numFrames += n - numFrames;
+              r.numCycles += atari->getCpu()->getNumCycles() - numCycles;
+            };
+          }};
+}
+
+static vector<Case> makeCases() {
+  vector<Case> cases;
+  for (bool step : {false, true}) {
+    for (auto mix : {"alu", "memory", "control"}) {
+      cases.push_back(makeCPUCase(mix, step));
+    }
+  }
+  cases.push_back(makeTIACase("TIA.cycle/kernel", TIA::RenderMode::full, false));
+  cases.push_back(makeTIACase("TIA.cycle/kernel/collisionsOnly",
+                              TIA::RenderMode::collisionsOnly, false));
+  cases.push_back(makeTIACase("TIA.advance/kernel", TIA::RenderMode::full, true));
+  cases.push_back(makePIACase(false));
+  cases.push_back(makePIACase(true));
+  for (auto const& format : cartridgeFormats) {
+    cases.push_back(makeCartridgeCase(format));
+  }
+  cases.push_back(makeStateCase("Atari2600.saveState", [](shared_ptr<Atari2600> atari) {
+    return [=]() { atari->saveState(); };
+  }));
+  cases.push_back(makeStateCase("Atari2600.loadState", [](shared_ptr<Atari2600> atari) {
+    auto state = atari->saveState();
+    return [=]() { atari->loadState(*state); };
+  }));
+  cases.push_back(
+      makeStateCase("Atari2600.saveStateInto", [](shared_ptr<Atari2600> atari) {
+        auto snapshot = make_shared<Atari2600Snapshot>();
+        return [=]() { atari->saveStateInto(*snapshot); };
+      }));
+  cases.push_back(
+      makeStateCase("Atari2600.loadStateFrom", [](shared_ptr<Atari2600> atari) {
+        auto snapshot = make_shared<Atari2600Snapshot>();
+        atari->saveStateInto(*snapshot);
+        return [=]() { atari->loadStateFrom(*snapshot); };
+      }));
+  cases.push_back(makeStateCase("Atari2600State.binary", [](shared_ptr<Atari2600> atari) {
+    auto state = atari->saveState();
+    auto bytes = make_shared<vector<uint8_t>>();
+    return [=]() {
+      bytes->clear();
+      BinaryWriter w(*bytes);
+      to_binary(w, *atari);
+      BinaryReader r(bytes->data(), bytes->data() + bytes->size());
+      from_binary(r, *state);
+    };
+  }));
+  cases.push_back(makeStateCase("Atari2600State.json", [](shared_ptr<Atari2600> atari) {
+    auto state = atari->saveState();
+    return [=]() {
+      json j;
+      to_json(j, *atari);
+      from_json(json::parse(j.dump()), *state);
+    };
+  }));
+  for (auto const& kernel : kernelROMs) {
+    for (bool fast : {false, true}) {
+      cases.push_back(makeSystemCase(kernel, fast));
+    }
+  }
+  return cases;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Run
+// -------------------------------------------------------------------
+
+/// Get the names of the benchmark cases.
+vector<string> jigo::getAtari2600BenchmarkNames() {
+  vector<string> names;
+  for (auto const& c : makeCases()) {
+    names.push_back(c.name);
+  }
+  return names;
+}
+
+/// Run the benchmark cases whose name contains `filter`. Each case runs a
+/// batch untimed to warm up, then batches until at least `minSeconds` have
+/// elapsed.
+vector<Atari2600BenchmarkResult> jigo::runAtari2600Benchmarks(double minSeconds,
+                                                              string const& filter) {
+  using clock = chrono::steady_clock;
+  vector<Atari2600BenchmarkResult> results;
+  for (auto const& c : makeCases()) {
+    if (c.name.find(filter) == string::npos) continue;
+    auto batch = c.setup();
+    Atari2600BenchmarkResult result{c.name, 0, 0, 0, 0};
+    batch(result);
+    result = {c.name, 0, 0, 0, 0};
+    auto start = clock::now();
+    do {
+      batch(result);
+      result.seconds = chrono::duration<double>(clock::now() - start).count();
+    } while (result.seconds < minSeconds);
+    results.push_back(result);
+  }
+  return results;
+}
+
+void jigo::to_json(json& j, Atari2600BenchmarkResult const& result) {
+  j = json{{"name", result.name}, {"seconds", result.seconds}};
+  if (result.numCycles > 0) {
+    j["numCycles"] = result.numCycles;
+    j["cyclesPerSecond"] = result.numCycles / result.seconds;
+  }
+  if (result.numFrames > 0) {
+    j["numFrames"] = result.numFrames;
+    j["framesPerSecond"] = result.numFrames / result.seconds;
+    j["nsPerFrame"] = 1e9 * result.seconds / result.numFrames;
+  }
+  if (result.numOperations > 0) {
+    j["numOperations"] = result.numOperations;
+    j["nsPerOperation"] = 1e9 * result.seconds / result.numOperations;
+  }
+}
@@ -0,0 +1,46 @@
+// Atari2600Benchmark.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600Benchmark_hpp
+#define Atari2600Benchmark_hpp
+
+#include "json.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Benchmarks
+// -----------------------------------------------------------------
+
+/// The outcome of a benchmark case. Cases count the work they do in CPU
+/// cycles, frames, or generic operations (such as a state save), as
+/// applicable; the rates derived from the counts that are zero are omitted
+/// in the JSON form.
+struct Atari2600BenchmarkResult {
+  std::string name;
+  double seconds;
+  std::uint64_t numCycles;
+  std::uint64_t numFrames;
+  std::uint64_t numOperations;
+};
+
+std::vector<char> makeBenchmarkKernelROM(size_t romSize, int minBankStrobe = 0,
+                                         bool superchip = false);
+std::vector<std::string> getAtari2600BenchmarkNames();
+std::vector<Atari2600BenchmarkResult>
+runAtari2600Benchmarks(double minSeconds = 0.25, std::string const& filter = "");
+
+void to_json(nlohmann::json& j, Atari2600BenchmarkResult const& result);
+
+} // namespace jigo
+
+#endif /* Atari2600Benchmark_hpp */
@@ -6,6 +6,7 @@
 // the terms of the BSD license (see the COPYING file).
 
 #include "Atari2600.hpp"
+#include "Atari2600Simulation.hpp"
 #include <algorithm>
 #include <array>
 #include <cstring>
@@ -26,6 +27,20 @@ constexpr size_t operator"" _KiB(unsigned long long n) {
 #undef jget
 #define jput(x) j[#x] = this->x
 #define jget(x) this->x = j.at(#x)
+#define bput(x) to_binary(w, this->x)
+#define bget(x) from_binary(r, this->x)
+#define sput(x) size = snapshotPut(data, size, this->x)
+#define sget(x) size = snapshotGet(data, size, this->x)
+
+template <typename T> size_t snapshotPut(uint8_t* data, size_t size, T const& x) {
+  memcpy(data + size, &x, sizeof(T));
+  return size + sizeof(T);
+}
+
+template <typename T> size_t snapshotGet(uint8_t const* data, size_t size, T& x) {
+  memcpy(&x, data + size, sizeof(T));
+  return size + sizeof(T);
+}
 
 // -------------------------------------------------------------------
 // MARK: - Serlialize & deserialize state
@@ -87,6 +102,10 @@ public:
   void reset() override {}
   void serialize(nlohmann::json& j) const override {}
   void deserialize(const nlohmann::json& j) override {}
+  void serialize(BinaryWriter& w) const override {}
+  void deserialize(BinaryReader& r) override {}
+  size_t saveInto(uint8_t* data) const override { return 0; }
+  size_t loadFrom(uint8_t const* data) override { return 0; }
 
   Atari2600Error load(Atari2600CartridgeState const& state) override {
     try {
@@ -121,10 +140,41 @@ private:
 
 // MARK: CartridgeHelper
 
+// The cartridge keeps a table mapping each 256-byte page of its address
+// space (0x1000-0x1fff) to the host memory that the CPU reads there. Pages
+// whose accesses have side effects, such as bank switching strobes and RAM
+// ports, are marked as not direct and handled by the full decoding logic.
+// The table is updated by `updatePages()` whenever the banks change.
+
 template <class Cartridge, class State, int romSize>
 class CartridgeHelper : public virtual Atari2600Cartridge, public State {
 public:
-  void reset() override { this->State::reset(); }
+  void reset() override {
+    this->State::reset();
+    updatePages();
+  }
+
+  void deserialize(const nlohmann::json& j) override {
+    this->State::deserialize(j);
+    updatePages();
+  }
+
+  void deserialize(BinaryReader& r) override {
+    this->State::deserialize(r);
+    updatePages();
+  }
+
+  size_t loadFrom(uint8_t const* data) override {
+    size_t size = this->State::loadFrom(data);
+    updatePages();
+    return size;
+  }
+
+  Atari2600Error load(Atari2600CartridgeState const& state) override {
+    auto error = this->State::load(state);
+    updatePages();
+    return error;
+  }
 
   void setVerbosity(int verbosity) override { this->verbosity = verbosity; }
 
@@ -169,9 +219,13 @@ public:
     assert(end >= begin);
     memset(&rom[0], 0, romSize);
     memcpy(&rom[0], begin, min((size_t)romSize, (size_t)(end - begin)));
+    updatePages();
   }
 
 protected:
+  using Atari2600Cartridge::pages;
+  using Atari2600Cartridge::updatePages;
+
   // Transient state.
   bool verbosity;
   array<uint8_t, romSize> rom;
@@ -253,6 +307,40 @@ public:
     }
   }
 
+  void serialize(BinaryWriter& w) const override {
+    this->super::serialize(w);
+    bput(activeBank);
+    if (ramSize) {
+      bput(ram);
+    }
+  }
+
+  void deserialize(BinaryReader& r) override {
+    this->super::deserialize(r);
+    bget(activeBank);
+    if (ramSize) {
+      bget(ram);
+    }
+  }
+
+  size_t saveInto(uint8_t* data) const override {
+    size_t size = this->super::saveInto(data);
+    sput(activeBank);
+    if (ramSize) {
+      sput(ram);
+    }
+    return size;
+  }
+
+  size_t loadFrom(uint8_t const* data) override {
+    size_t size = this->super::loadFrom(data);
+    sget(activeBank);
+    if (ramSize) {
+      sget(ram);
+    }
+    return size;
+  }
+
 protected:
   int activeBank;
   array<uint8_t, ramSize> ram;
@@ -283,8 +371,18 @@ public:
     if (!chipSelect) {
       return 0;
     }
-    uint32_t naddress =
-        machine.getCpu()->getAddressBus() & ((romSize == 2_KiB) ? 0x07ff : 0x0fff);
+    uint32_t address = machine.getCpu()->getAddressBus();
+
+    // Regular ROM operation.
+    auto const& page = this->pages[(address >> 8) & 0xf];
+    if (page.direct) {
+      if (machine.getCpu()->getRW()) {
+        machine.getCpu()->setDataBus(page.data[address & 0xff]);
+      }
+      return (uint32_t)(page.data - &rom[0]) + (address & 0xff);
+    }
+
+    uint32_t naddress = address & ((romSize == 2_KiB) ? 0x07ff : 0x0fff);
 
     // RAM operation.
     if (naddress < 2 * ramSize) {
@@ -303,11 +401,12 @@ public:
       int bank = (int)naddress - minBankStrobe;
       if (0 <= bank && bank < numBanks) {
         activeBank = bank;
+        updatePages();
         return naddress;
       }
     }
 
-    // Regular ROM operation.
+    // ROM operation in a page with strobes.
     naddress = naddress + 4_KiB * activeBank;
     if (machine.getCpu()->getRW()) {
       auto value = rom[naddress];
@@ -348,6 +447,22 @@ public:
   int getNumBanks() const override { return numBanks; }
 
   int getNumRegions() const override { return numBanks + (ramSize > 0); }
+
+protected:
+  void updatePages() override {
+    uint32_t mask = (romSize == 2_KiB) ? 0x07ff : 0x0fff;
+    for (int k = 0; k < this->numPages; ++k) {
+      uint32_t naddress = (k * this->pageSize) & mask;
+      auto& page = this->pages[k];
+      if (naddress < 2 * ramSize) {
+        page = {nullptr, 0, false};
+      } else {
+        page.data = &rom[naddress + 4_KiB * activeBank];
+        page.virtualAddress = (activeBank << 16) | 0xf000 | naddress;
+        page.direct = (numBanks == 1) || (k < this->numPages - 1);
+      }
+    }
+  }
 };
 
 // Instantiate standard cartridge classes.
@@ -358,7 +473,7 @@ public:
     Atari2600Cartridge##x##State&                                             \
     operator=(Atari2600Cartridge##x##State const&) = default;                 \
   };                                                                          \
-  class Atari2600Cartridge##x                                                 \
+  class Atari2600Cartridge##x final                                           \
    : public Standard<Atari2600Cartridge##x, Atari2600Cartridge##x##State> {   \
   public:                                                                     \
     Atari2600Cartridge##x& operator=(Atari2600Cartridge##x const&) = default; \
@@ -393,18 +508,30 @@ template <> struct traits<Type::F0> {
 struct Atari2600CartridgeF0State
  : public StandardState<Atari2600CartridgeF0State, Type::F0> {};
 
-struct Atari2600CartridgeF0
+struct Atari2600CartridgeF0 final
  : public Standard<Atari2600Cartridge, Atari2600CartridgeF0State> {
   uint32_t cycle(Atari2600& machine, bool chipSelect) override {
     // Nothing to do if not chip select.
     if (!chipSelect) {
       return 0;
     }
-    std::uint16_t naddress = machine.getCpu()->getAddressBus() & 0x0fff;
+    std::uint16_t address = machine.getCpu()->getAddressBus();
+
+    // Regular ROM operation.
+    auto const& page = this->pages[(address >> 8) & 0xf];
+    if (page.direct) {
+      if (machine.getCpu()->getRW()) {
+        machine.getCpu()->setDataBus(page.data[address & 0xff]);
+      }
+      return (uint32_t)(page.data - &this->rom[0]) + (address & 0xff);
+    }
+
+    std::uint16_t naddress = address & 0x0fff;
 
     // Bank switching operation.
     if (naddress == 0xff0) {
       this->activeBank = (this->activeBank + 1) & 0xf;
+      updatePages();
       return naddress;
     } else if (naddress == 0x1fec) {
       if (machine.getCpu()->getRW()) {
@@ -413,7 +540,7 @@ struct Atari2600CartridgeF0
       return naddress;
     }
 
-    // Regular ROM operation.
+    // ROM operation in the page with the strobe.
     naddress += 4_KiB * this->activeBank;
     if (machine.getCpu()->getRW()) {
       auto value = this->rom[naddress];
@@ -457,6 +584,28 @@ public:
     jget(activeBanks);
   }
 
+  void serialize(BinaryWriter& w) const override {
+    this->super::serialize(w);
+    bput(activeBanks);
+  }
+
+  void deserialize(BinaryReader& r) override {
+    this->super::deserialize(r);
+    bget(activeBanks);
+  }
+
+  size_t saveInto(uint8_t* data) const override {
+    size_t size = this->super::saveInto(data);
+    sput(activeBanks);
+    return size;
+  }
+
+  size_t loadFrom(uint8_t const* data) override {
+    size_t size = this->super::loadFrom(data);
+    sget(activeBanks);
+    return size;
+  }
+
   Atari2600CartridgeE0State& operator=(Atari2600CartridgeE0State const&) = default;
 
 protected:
@@ -466,13 +615,14 @@ private:
   using super = StateHelper<Atari2600CartridgeE0State, Type::E0, 0>;
 };
 
-class Atari2600CartridgeE0
+class Atari2600CartridgeE0 final
  : public CartridgeHelper<Atari2600CartridgeE0, Atari2600CartridgeE0State,
                           Atari2600CartridgeE0State::romSize> {
 public:
   void reset() override {
     this->super::reset();
     fill(begin(this->activeBanks), end(this->activeBanks), 0);
+    updatePages();
   }
 
   uint32_t cycle(Atari2600& machine, bool chipSelect) override {
@@ -480,7 +630,18 @@ public:
     if (!chipSelect) {
       return 0;
     }
-    uint32_t naddress = machine.getCpu()->getAddressBus() & 0x0fff;
+    uint32_t address = machine.getCpu()->getAddressBus();
+
+    // Regular ROM operation.
+    auto const& page = this->pages[(address >> 8) & 0xf];
+    if (page.direct) {
+      if (machine.getCpu()->getRW()) {
+        machine.getCpu()->setDataBus(page.data[address & 0xff]);
+      }
+      return (uint32_t)(page.data - &rom[0]) + (address & 0xff);
+    }
+
+    uint32_t naddress = address & 0x0fff;
 
     // Bank switching operation.
     if (!((naddress ^ 0xfe0) & 0xfe0)) {
@@ -488,18 +649,21 @@ public:
       if (bank >= 0) {
         if (bank < 8) {
           this->activeBanks[0] = bank;
+          updatePages();
           return naddress;
         } else if (bank < 16) {
           this->activeBanks[1] = bank - 8;
+          updatePages();
           return naddress;
         } else if (bank < 24) {
           this->activeBanks[2] = bank - 16;
+          updatePages();
           return naddress;
         }
       }
     }
 
-    // Regular ROM operation.
+    // ROM operation in the page with the strobes.
     int slice = naddress >> 10;
     int offset = naddress & 0x3ff;
     if (slice == 3) {
@@ -541,6 +705,8 @@ public:
 
   int getNumBanks() const override { return this->numBanks; }
 
+  int getNumRegions() const override { return this->numBanks; }
+
   Region getRegion(int number) const override {
     // Unusual 1024 banks.
     assert(number < getNumBanks());
@@ -553,6 +719,18 @@ public:
     return b;
   }
 
+protected:
+  void updatePages() override {
+    for (int k = 0; k < numPages; ++k) {
+      int slice = k >> 2;
+      int bank = (slice == 3) ? 7 : this->activeBanks[slice];
+      uint32_t offset = (k * pageSize) & 0x3ff;
+      pages[k].data = &rom[1_KiB * bank + offset];
+      pages[k].virtualAddress = (bank << 16) | 0xf000 | offset;
+      pages[k].direct = (k < numPages - 1);
+    }
+  }
+
 private:
   using super = CartridgeHelper<Atari2600CartridgeE0, Atari2600CartridgeE0State,
                                 Atari2600CartridgeE0State::romSize>;
@@ -593,6 +771,32 @@ public:
     jget(feDetected);
   }
 
+  void serialize(BinaryWriter& w) const override {
+    this->super::serialize(w);
+    bput(activeBank);
+    bput(feDetected);
+  }
+
+  void deserialize(BinaryReader& r) override {
+    this->super::deserialize(r);
+    bget(activeBank);
+    bget(feDetected);
+  }
+
+  size_t saveInto(uint8_t* data) const override {
+    size_t size = this->super::saveInto(data);
+    sput(activeBank);
+    sput(feDetected);
+    return size;
+  }
+
+  size_t loadFrom(uint8_t const* data) override {
+    size_t size = this->super::loadFrom(data);
+    sget(activeBank);
+    sget(feDetected);
+    return size;
+  }
+
   Atari2600CartridgeFEState& operator=(Atari2600CartridgeFEState const&) = default;
 
 protected:
@@ -603,7 +807,7 @@ private:
   using super = StateHelper<Atari2600CartridgeFEState, Type::FE, 0>;
 };
 
-class Atari2600CartridgeFE
+class Atari2600CartridgeFE final
  : public CartridgeHelper<Atari2600CartridgeFE, Atari2600CartridgeFEState,
                           Atari2600CartridgeE0State::romSize> {
 public:
@@ -613,7 +817,7 @@ public:
     if (chipSelect) {
       naddress = (address & 0x0fff) + activeBank * 4_KiB;
       if (machine.getCpu()->getRW()) {
-        auto value = rom[naddress];
+        auto value = pages[(address >> 8) & 0xf].data[address & 0xff];
         machine.getCpu()->setDataBus(value);
       } else {
         // Pass.
@@ -621,7 +825,11 @@ public:
     }
 
     if (feDetected) {
-      activeBank = (machine.getCpu()->getDataBus() & 0x20) ? 0 : 1;
+      int bank = (machine.getCpu()->getDataBus() & 0x20) ? 0 : 1;
+      if (bank != activeBank) {
+        activeBank = bank;
+        updatePages();
+      }
     }
 
     feDetected = ((address & 0xfff) == 0x1fe) && !chipSelect;
@@ -635,6 +843,15 @@ public:
     if ((pc & 0x1000) == 0) return 0; // Not a ROM address.
     return (pc & 0x0fff) | (activeBank == 1 ? 0x1f000 : 0xf000);
   }
+
+protected:
+  void updatePages() override {
+    for (int k = 0; k < numPages; ++k) {
+      pages[k].data = &rom[activeBank * 4_KiB + k * pageSize];
+      pages[k].virtualAddress = (activeBank == 1 ? 0x1f000 : 0xf000) | (k * pageSize);
+      pages[k].direct = true;
+    }
+  }
 };
 
 // -------------------------------------------------------------------
@@ -737,3 +954,39 @@ jigo::makeCartridgeFromBytes(const std::vector<char>& data,
                              Atari2600Cartridge::Type type) {
   return jigo::makeCartridgeFromBytes(&*begin(data), &*end(data), type);
 }
+
+/// Select the simulation loop specialized for the type of the cartridge, in
+/// which the cartridge methods are called directly. This is defined here as
+/// the concrete cartridge classes are private to this file.
+void Atari2600::selectCycleFunction() {
+  cycleFunction = &Atari2600::cycleWithCartridge<Atari2600Cartridge>;
+  concreteCartridge = cartridgeInterface;
+  if (!cartridgeInterface || !staticCartridgeDispatch) {
+    return;
+  }
+#undef m
+#define m(x)                                                                  \
+  case Type::x:                                                               \
+    concreteCartridge = dynamic_cast<Atari2600Cartridge##x*>(cartridgeInterface); \
+    cycleFunction = &Atari2600::cycleWithCartridge<Atari2600Cartridge##x>;    \
+    break;
+  switch (cartridgeInterface->getType()) {
+    m(S2K);
+    m(S4K);
+    m(S8K);
+    m(S12K);
+    m(S16K);
+    m(S32K);
+    m(S2K128R);
+    m(S4K128R);
+    m(S8K128R);
+    m(S12K128R);
+    m(S16K128R);
+    m(S32K128R);
+    m(F0);
+    m(E0);
+    m(FE);
+  default: break;
+  }
+#undef m
+}
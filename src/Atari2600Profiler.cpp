@@ -0,0 +1,87 @@
+// Atari2600Profiler.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "Atari2600Profiler.hpp"
+#include "Atari2600.hpp"
+
+#include <array>
+#include <iomanip>
+
+using namespace std;
+using namespace jigo;
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+Atari2600Profiler::Atari2600Profiler()
+ : numInstructions(numAddresses), numCycles(numAddresses), numStalledCycles(numAddresses),
+   heatmap(2 * numLines * numLineCycles), totalNumInstructions(0), totalNumCycles(0),
+   current(0) {}
+
+/// Reset all the counters.
+void Atari2600Profiler::clear() {
+  fill(numInstructions.begin(), numInstructions.end(), 0);
+  fill(numCycles.begin(), numCycles.end(), 0);
+  fill(numStalledCycles.begin(), numStalledCycles.end(), 0);
+  fill(heatmap.begin(), heatmap.end(), 0);
+  totalNumInstructions = 0;
+  totalNumCycles = 0;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Inspect
+// -------------------------------------------------------------------
+
+/// Map the index of a counter back to the virtual address of its instruction.
+uint32_t Atari2600Profiler::getVirtualAddress(size_t index) {
+  auto bank = static_cast<uint32_t>(index / bankSize);
+  auto offset = static_cast<uint32_t>(index % bankSize);
+  if (offset & 0x1000) {
+    offset |= 0xf000;
+  }
+  return (bank << 16) | offset;
+}
+
+/// Return the addresses with at least one cycle, by decreasing number of
+/// cycles.
+vector<Atari2600ProfileEntry> Atari2600Profiler::getFlatProfile() const {
+  vector<Atari2600ProfileEntry> entries;
+  for (size_t k = 0; k < numAddresses; ++k) {
+    if (numCycles[k] > 0) {
+      entries.push_back(
+          {getVirtualAddress(k), numInstructions[k], numCycles[k], numStalledCycles[k]});
+    }
+  }
+  stable_sort(entries.begin(), entries.end(),
+              [](Atari2600ProfileEntry const& a, Atari2600ProfileEntry const& b) {
+                return a.numCycles > b.numCycles;
+              });
+  return entries;
+}
+
+/// Print the first `maxNumEntries` entries of the flat profile, with the
+/// instructions disassembled from the memory of `atari`.
+void jigo::printProfile(ostream& os, Atari2600 const& atari,
+                        Atari2600Profiler const& profiler, size_t maxNumEntries) {
+  auto entries = profiler.getFlatProfile();
+  auto total = max<uint64_t>(profiler.getTotalNumCycles(), 1);
+  os << "address  instructions        cycles   stalled       %  instruction\n";
+  for (size_t k = 0; k < min(maxNumEntries, entries.size()); ++k) {
+    auto const& e = entries[k];
+    array<uint8_t, 3> bytes;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+      bytes[i] = atari.peek(e.virtualAddress + (uint32_t)i);
+    }
+    os << hex << setfill('0') << uppercase << setw(2) << (e.virtualAddress >> 16) << ":"
+       << setw(4) << (e.virtualAddress & 0xffff) << dec << setfill(' ') << setw(14)
+       << e.numInstructions << setw(14) << e.numCycles << setw(10) << e.numStalledCycles
+       << fixed << setprecision(2) << setw(8) << (100.0 * e.numCycles / total) << "  ";
+    Atari2600::printInstruction(os, M6502::decode(bytes)) << "\n";
+  }
+  os << dec << setfill(' ');
+}
@@ -0,0 +1,127 @@
+// Atari2600Profiler.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600Profiler_hpp
+#define Atari2600Profiler_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace jigo {
+class Atari2600;
+
+// -----------------------------------------------------------------
+// MARK: - Profiler
+// -----------------------------------------------------------------
+
+/// An entry of the flat profile.
+struct Atari2600ProfileEntry {
+  std::uint32_t virtualAddress;
+  std::uint64_t numInstructions;
+  std::uint64_t numCycles;        /// Including the stalled cycles.
+  std::uint64_t numStalledCycles; /// Cycles stalled by WSYNC.
+};
+
+/// Count the instructions executed and the CPU cycles spent at each
+/// virtual address (see `Atari2600::setProfiler()`), and the CPU cycles
+/// spent at each beam position.
+///
+/// An instruction is charged with the cycles from its second (T1) to the
+/// opcode fetch of the next one, which adds up to its nominal duration and
+/// includes the cycles in which the CPU waits for the end of the line after
+/// `STA WSYNC`.
+///
+/// The counters are dense arrays indexed by `getIndex()`. Each bank spans
+/// 8 KiB: the cartridge addresses $F000-$FFFF of the bank and, for bank 0,
+/// the RAM and the registers ($0000-$0FFF), where code can also run. The
+/// heatmap is a [2][numLines][numLineCycles] array counting the executed
+/// and the stalled cycles, respectively, at each scanline and CPU cycle
+/// within it.
+class Atari2600Profiler {
+public:
+  static constexpr int maxNumBanks = 32;
+  static constexpr size_t bankSize = 0x2000;
+  static constexpr size_t numAddresses = maxNumBanks * bankSize;
+  static constexpr int numLines = 312;
+  static constexpr int numLineCycles = 76;
+
+  // Lifecycle.
+  Atari2600Profiler();
+  void clear();
+
+  // Record.
+  void beginInstruction(std::uint32_t virtualAddress);
+  void addCycles(size_t n, bool stalled, int beamX, int beamY);
+
+  // Inspect.
+  static size_t getIndex(std::uint32_t virtualAddress);
+  static std::uint32_t getVirtualAddress(size_t index);
+  std::uint64_t const* getNumInstructions() const { return numInstructions.data(); }
+  std::uint64_t const* getNumCycles() const { return numCycles.data(); }
+  std::uint64_t const* getNumStalledCycles() const { return numStalledCycles.data(); }
+  std::uint32_t const* getHeatmap() const { return heatmap.data(); }
+  std::uint64_t getTotalNumInstructions() const { return totalNumInstructions; }
+  std::uint64_t getTotalNumCycles() const { return totalNumCycles; }
+  std::vector<Atari2600ProfileEntry> getFlatProfile() const;
+
+protected:
+  std::vector<std::uint64_t> numInstructions;
+  std::vector<std::uint64_t> numCycles;
+  std::vector<std::uint64_t> numStalledCycles;
+  std::vector<std::uint32_t> heatmap;
+  std::uint64_t totalNumInstructions;
+  std::uint64_t totalNumCycles;
+  size_t current;
+};
+
+void printProfile(std::ostream& os, Atari2600 const& atari,
+                  Atari2600Profiler const& profiler, size_t maxNumEntries);
+
+// -----------------------------------------------------------------
+// MARK: - Inline members
+// -----------------------------------------------------------------
+
+/// Map the virtual address of an instruction to the index of its counters.
+inline size_t Atari2600Profiler::getIndex(std::uint32_t virtualAddress) {
+  size_t bank = std::min<size_t>(virtualAddress >> 16, maxNumBanks - 1);
+  return bank * bankSize + (virtualAddress & 0x1fff);
+}
+
+/// Start charging the cycles to the instruction at `virtualAddress`.
+inline void Atari2600Profiler::beginInstruction(std::uint32_t virtualAddress) {
+  current = getIndex(virtualAddress);
+  ++numInstructions[current];
+  ++totalNumInstructions;
+}
+
+/// Charge `n` cycles to the current instruction. The first ends at the
+/// beam position (`beamX`, `beamY`), and the others follow at intervals of
+/// three color clocks.
+inline void Atari2600Profiler::addCycles(size_t n, bool stalled, int beamX, int beamY) {
+  numCycles[current] += n;
+  totalNumCycles += n;
+  if (stalled) {
+    numStalledCycles[current] += n;
+  }
+  auto plane = heatmap.data() + (stalled ? numLines * numLineCycles : 0);
+  for (size_t k = 0; k < n; ++k, beamX += 3) {
+    while (beamX >= 228) {
+      beamX -= 228;
+      ++beamY;
+    }
+    if (0 <= beamY && beamY < numLines) {
+      ++plane[beamY * numLineCycles + beamX / 3];
+    }
+  }
+}
+
+} // namespace jigo
+
+#endif /* Atari2600Profiler_hpp */
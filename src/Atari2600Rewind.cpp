@@ -0,0 +1,203 @@
+// Atari2600Rewind.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "Atari2600Rewind.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+using namespace jigo;
+
+// -------------------------------------------------------------------
+// MARK: - Helpers
+// -------------------------------------------------------------------
+
+static void putCount(vector<uint8_t>& data, size_t n) {
+  while (n >= 0x80) {
+    data.push_back(static_cast<uint8_t>(n | 0x80));
+    n >>= 7;
+  }
+  data.push_back(static_cast<uint8_t>(n));
+}
+
+static size_t getCount(uint8_t const*& p) {
+  size_t n = 0;
+  for (int shift = 0;; shift += 7) {
+    n |= static_cast<size_t>(*p & 0x7f) << shift;
+    if ((*p++ & 0x80) == 0) break;
+  }
+  return n;
+}
+
+/// Encode `to` as the XOR with `from`, which must have the same size. The
+/// XOR is stored as a sequence of (number of zero bytes, number of nonzero
+/// bytes, nonzero bytes) triplets.
+void Atari2600Rewind::encodeDelta(vector<uint8_t>& delta, vector<uint8_t> const& from,
+                                  vector<uint8_t> const& to) {
+  assert(from.size() == to.size());
+  delta.clear();
+  size_t pos = 0;
+  while (pos < to.size()) {
+    size_t start = pos;
+    while (pos < to.size() && from[pos] == to[pos]) ++pos;
+    putCount(delta, pos - start);
+    start = pos;
+    while (pos < to.size() && from[pos] != to[pos]) ++pos;
+    putCount(delta, pos - start);
+    for (size_t k = start; k < pos; ++k) {
+      delta.push_back(from[k] ^ to[k]);
+    }
+  }
+}
+
+/// Apply in place a delta obtained from `encodeDelta()`.
+void Atari2600Rewind::applyDelta(vector<uint8_t>& state, vector<uint8_t> const& delta) {
+  auto p = delta.data();
+  auto end = p + delta.size();
+  size_t pos = 0;
+  while (p < end) {
+    pos += getCount(p);
+    size_t n = getCount(p);
+    for (size_t k = 0; k < n; ++k) {
+      state[pos++] ^= *p++;
+    }
+  }
+}
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+/// Create a history of at most `capacity` captures of `machine`, storing a
+/// full keyframe every `keyframeInterval` captures.
+Atari2600Rewind::Atari2600Rewind(shared_ptr<Atari2600> machine, size_t capacity,
+                                 size_t keyframeInterval)
+ : machine(machine), keyframeInterval(max((size_t)1, keyframeInterval)),
+   entries(max((size_t)1, capacity)), first(0), numEntries(0), numSinceKeyframe(0),
+   seekNumEntries(0), seekNumSinceKeyframe(0) {
+  assert(machine);
+  scratch = machine->makeState();
+}
+
+/// Drop all captures.
+void Atari2600Rewind::clear() {
+  first = 0;
+  numEntries = 0;
+  numSinceKeyframe = 0;
+  seekNumEntries = 0;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Operate
+// -------------------------------------------------------------------
+
+/// Capture the current machine state, normally once per frame. Once the
+/// history is full, the storage of the dropped captures is reused, so that
+/// capturing does not allocate memory.
+void Atari2600Rewind::capture() {
+  if (seekNumEntries) {
+    numEntries = seekNumEntries;
+    numSinceKeyframe = seekNumSinceKeyframe;
+    seekNumEntries = 0;
+  }
+  current.clear();
+  BinaryWriter w(current);
+  to_binary(w, *machine);
+
+  if (numEntries == entries.size()) {
+    dropFirst();
+  }
+  auto& entry = entryAt(numEntries);
+  entry.frameNumber = machine->getFrameNumber();
+  entry.keyframe = (numEntries == 0) || (numSinceKeyframe + 1 >= keyframeInterval) ||
+                   (previous.size() != current.size());
+  if (entry.keyframe) {
+    entry.data.assign(current.begin(), current.end());
+    numSinceKeyframe = 0;
+  } else {
+    encodeDelta(entry.data, previous, current);
+    numSinceKeyframe++;
+  }
+  numEntries++;
+  swap(previous, current);
+}
+
+/// Drop the oldest capture. If the next one is a delta, it is turned into a
+/// keyframe.
+void Atari2600Rewind::dropFirst() {
+  assert(numEntries > 0);
+  auto& oldest = entryAt(0);
+  assert(oldest.keyframe);
+  if (numEntries > 1) {
+    auto& next = entryAt(1);
+    if (!next.keyframe) {
+      applyDelta(oldest.data, next.data);
+      swap(oldest.data, next.data);
+      next.keyframe = true;
+    }
+  }
+  first = (first + 1) % entries.size();
+  numEntries--;
+}
+
+/// Restore the machine to the last capture of frame `frameNumber` by
+/// decoding forward from the nearest preceding keyframe. The captures that
+/// follow are kept until the next call to `capture()`, which discards them
+/// and resumes the history from that point. Returns `false` if no such
+/// capture exists.
+bool Atari2600Rewind::seek(long long frameNumber) {
+  size_t index = numEntries;
+  while (index > 0 && entryAt(index - 1).frameNumber != frameNumber) {
+    index--;
+  }
+  if (index == 0) {
+    return false;
+  }
+  index--;
+
+  size_t keyframe = index;
+  while (!entryAt(keyframe).keyframe) {
+    keyframe--;
+  }
+  auto const& data = entryAt(keyframe).data;
+  previous.assign(data.begin(), data.end());
+  for (size_t k = keyframe + 1; k <= index; ++k) {
+    applyDelta(previous, entryAt(k).data);
+  }
+
+  BinaryReader r(previous.data(), previous.data() + previous.size());
+  from_binary(r, *scratch);
+  machine->loadState(*scratch);
+
+  seekNumEntries = index + 1;
+  seekNumSinceKeyframe = index - keyframe;
+  return true;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Inspect
+// -------------------------------------------------------------------
+
+/// Get the frame number of the oldest capture, or -1 if there is none.
+long long Atari2600Rewind::getFirstFrameNumber() const {
+  return numEntries ? entryAt(0).frameNumber : -1;
+}
+
+/// Get the frame number of the newest capture, or -1 if there is none.
+long long Atari2600Rewind::getLastFrameNumber() const {
+  return numEntries ? entryAt(numEntries - 1).frameNumber : -1;
+}
+
+/// Get the number of bytes used to store the captures.
+size_t Atari2600Rewind::getNumBytes() const {
+  size_t numBytes = 0;
+  for (size_t k = 0; k < numEntries; ++k) {
+    numBytes += entryAt(k).data.size();
+  }
+  return numBytes;
+}
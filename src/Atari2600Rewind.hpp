@@ -0,0 +1,80 @@
+// Atari2600Rewind.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600Rewind_hpp
+#define Atari2600Rewind_hpp
+
+#include "Atari2600.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Atari2600Rewind
+// -----------------------------------------------------------------
+
+/// A bounded history of machine states for rewinding. States are captured
+/// in the binary format (see `to_binary()`). Every `keyframeInterval`
+/// captures a full keyframe is stored; the other captures are stored as
+/// the run-length encoded XOR with the previous capture. When the history
+/// is full, the oldest capture is dropped.
+class Atari2600Rewind {
+public:
+  // Lifecycle.
+  Atari2600Rewind(std::shared_ptr<Atari2600> machine, size_t capacity,
+                  size_t keyframeInterval = 60);
+
+  // Operate.
+  void capture();
+  bool seek(long long frameNumber);
+  void clear();
+
+  // Inspect.
+  size_t size() const { return numEntries; }
+  size_t getCapacity() const { return entries.size(); }
+  long long getFirstFrameNumber() const;
+  long long getLastFrameNumber() const;
+  size_t getNumBytes() const;
+
+protected:
+  struct Entry {
+    long long frameNumber;
+    bool keyframe;
+    std::vector<std::uint8_t> data;
+  };
+
+  Entry& entryAt(size_t index) { return entries[(first + index) % entries.size()]; }
+  Entry const& entryAt(size_t index) const {
+    return entries[(first + index) % entries.size()];
+  }
+  void dropFirst();
+
+  static void encodeDelta(std::vector<std::uint8_t>& delta,
+                          std::vector<std::uint8_t> const& from,
+                          std::vector<std::uint8_t> const& to);
+  static void applyDelta(std::vector<std::uint8_t>& state,
+                         std::vector<std::uint8_t> const& delta);
+
+  std::shared_ptr<Atari2600> machine;
+  std::shared_ptr<Atari2600State> scratch;
+  size_t keyframeInterval;
+  std::vector<Entry> entries;
+  size_t first;
+  size_t numEntries;
+  size_t numSinceKeyframe;
+  size_t seekNumEntries;
+  size_t seekNumSinceKeyframe;
+  std::vector<std::uint8_t> previous;
+  std::vector<std::uint8_t> current;
+};
+
+} // namespace jigo
+
+#endif /* Atari2600Rewind_hpp */
@@ -0,0 +1,179 @@
+// Atari2600Rollback.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "Atari2600Rollback.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+using namespace std;
+using namespace jigo;
+
+// -------------------------------------------------------------------
+// MARK: - Helpers
+// -------------------------------------------------------------------
+
+static bool isSameInput(Atari2600::FrameInput const& a, Atari2600::FrameInput const& b) {
+  return a.panel == b.panel && a.joysticks[0] == b.joysticks[0] &&
+         a.joysticks[1] == b.joysticks[1] && a.paddleFires == b.paddleFires &&
+         equal(begin(a.paddleAngles), end(a.paddleAngles), begin(b.paddleAngles));
+}
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+/// Create a session driving `machine` from its current state, in which
+/// `localPlayer` (0 or 1) is the local player. Late remote inputs can roll
+/// the machine back by up to `maxNumRollbackFrames` frames.
+Atari2600RollbackSession::Atari2600RollbackSession(shared_ptr<Atari2600> machine,
+                                                   size_t maxNumRollbackFrames,
+                                                   int localPlayer)
+ : machine(machine), localPlayer(localPlayer),
+   entries(2 * max((size_t)1, maxNumRollbackFrames)), frameNumber(0),
+   lastRemoteFrameNumber(-1), rollbackFrameNumber(noRollback), numRollbacks(0),
+   numResimulatedFrames(0) {
+  assert(machine);
+  if (localPlayer != 0 && localPlayer != 1) {
+    throw invalid_argument("The local player must be 0 or 1");
+  }
+  initialInput = FrameInput{};
+  initialInput.panel = static_cast<uint8_t>(machine->getPanel().to_ulong());
+  localInput = initialInput;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Operate
+// -------------------------------------------------------------------
+
+/// Get the entry of frame `frameNumber`, which must not be negative,
+/// recycling the one of an older frame in the same slot.
+Atari2600RollbackSession::Entry&
+Atari2600RollbackSession::entryAt(long long frameNumber) {
+  assert(frameNumber >= 0);
+  auto& entry = entries[static_cast<size_t>(frameNumber) % entries.size()];
+  if (entry.frameNumber != frameNumber) {
+    entry.frameNumber = frameNumber;
+    entry.received = false;
+  }
+  return entry;
+}
+
+/// Set the input of the remote player for frame `frameNumber`. If the frame
+/// has already run with a different input, the machine is rolled back to
+/// it by the next call to `advanceFrame()`. Throws `std::invalid_argument`
+/// if the frame is negative, too old to roll back to, or too far ahead.
+void Atari2600RollbackSession::setRemoteInput(long long frameNumber,
+                                              FrameInput const& input) {
+  auto n = static_cast<long long>(getMaxNumRollbackFrames());
+  if (frameNumber < 0 || frameNumber < this->frameNumber - n ||
+      frameNumber >= this->frameNumber + n) {
+    throw invalid_argument("The remote input is out of the rollback window");
+  }
+  auto& entry = entryAt(frameNumber);
+  entry.remoteInput = input;
+  entry.received = true;
+  lastRemoteFrameNumber = max(lastRemoteFrameNumber, frameNumber);
+  if (frameNumber < this->frameNumber && !isSameInput(entry.usedRemoteInput, input)) {
+    rollbackFrameNumber = min(rollbackFrameNumber, frameNumber);
+  }
+}
+
+/// Predict the remote input of frame `frameNumber` as the closest preceding
+/// one received, if still in the history, or the initial input otherwise.
+Atari2600RollbackSession::FrameInput const&
+Atari2600RollbackSession::predictRemoteInput(long long frameNumber) {
+  auto& entry = entryAt(frameNumber);
+  if (entry.received) {
+    return entry.remoteInput;
+  }
+  auto const numEntries = static_cast<long long>(entries.size());
+  for (long long f = frameNumber - 1; f >= 0 && f > frameNumber - numEntries; --f) {
+    auto const& previous = entries[static_cast<size_t>(f) % entries.size()];
+    if (previous.frameNumber != f) break;
+    if (previous.received) return previous.remoteInput;
+  }
+  return initialInput;
+}
+
+/// Combine the inputs of the two players.
+Atari2600RollbackSession::FrameInput
+Atari2600RollbackSession::combine(FrameInput const& local,
+                                  FrameInput const& remote) const {
+  FrameInput const* players[2] = {&local, &remote};
+  if (localPlayer == 1) {
+    swap(players[0], players[1]);
+  }
+  FrameInput input;
+  input.panel = players[0]->panel | players[1]->panel;
+  input.paddleFires = 0;
+  for (int k = 0; k < 2; ++k) {
+    input.joysticks[k] = players[k]->joysticks[k];
+    input.paddleFires |= players[k]->paddleFires & (0x3 << (2 * k));
+    input.paddleAngles[2 * k] = players[k]->paddleAngles[2 * k];
+    input.paddleAngles[2 * k + 1] = players[k]->paddleAngles[2 * k + 1];
+  }
+  return input;
+}
+
+/// Save the snapshot of frame `frameNumber` and run it with the recorded
+/// local input and the best known remote input.
+Atari2600::StoppingReason Atari2600RollbackSession::runFrame(long long frameNumber,
+                                                             size_t maxNumCPUCycles) {
+  auto& entry = entryAt(frameNumber);
+  machine->saveStateInto(entry.snapshot);
+  entry.usedRemoteInput = predictRemoteInput(frameNumber);
+  auto input = combine(entry.localInput, entry.usedRemoteInput);
+  size_t numFrames = 1;
+  return machine->runFrames(numFrames, &input, nullptr, maxNumCPUCycles);
+}
+
+/// Restore the snapshot of the oldest frame with a mispredicted remote
+/// input and run again the frames up to the current one. These are run
+/// without drawing pixels and producing sound, but the collision latches
+/// and the sound generators are updated so that the result is the same as
+/// in the normal modes. Attached observers, such as a profiler, see the
+/// frames again.
+void Atari2600RollbackSession::resimulate(size_t maxNumCPUCycles) {
+  auto first = rollbackFrameNumber;
+  rollbackFrameNumber = noRollback;
+  auto error = machine->loadStateFrom(entryAt(first).snapshot);
+  if (error != Atari2600Error::success) {
+    throw runtime_error("Cannot restore the rollback snapshot");
+  }
+
+  auto& tia = *machine->getTia();
+  auto renderMode = tia.getRenderMode();
+  auto audioMode = tia.getAudioMode();
+  if (renderMode == TIA::RenderMode::full || renderMode == TIA::RenderMode::indexed) {
+    tia.setRenderMode(TIA::RenderMode::collisionsOnly);
+  }
+  if (audioMode == TIA::AudioMode::full) {
+    tia.setAudioMode(TIA::AudioMode::samplesOnly);
+  }
+  for (auto f = first; f < frameNumber; ++f) {
+    runFrame(f, maxNumCPUCycles);
+  }
+  tia.setRenderMode(renderMode);
+  tia.setAudioMode(audioMode);
+
+  ++numRollbacks;
+  numResimulatedFrames += frameNumber - first;
+}
+
+/// Run the current frame with the last local input set, after rolling back
+/// if required. Only this frame is rendered and produces sound.
+Atari2600::StoppingReason Atari2600RollbackSession::advanceFrame(size_t maxNumCPUCycles) {
+  if (rollbackFrameNumber < frameNumber) {
+    resimulate(maxNumCPUCycles);
+  }
+  entryAt(frameNumber).localInput = localInput;
+  auto reason = runFrame(frameNumber, maxNumCPUCycles);
+  ++frameNumber;
+  return reason;
+}
@@ -0,0 +1,90 @@
+// Atari2600Rollback.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600Rollback_hpp
+#define Atari2600Rollback_hpp
+
+#include "Atari2600.hpp"
+
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Atari2600RollbackSession
+// -----------------------------------------------------------------
+
+/// A two-player session with rollback. Each frame runs with the input of
+/// the local player and the input of the remote player for that frame if
+/// it has arrived, or a prediction otherwise: the input of the closest
+/// preceding frame received. When a late remote input differs from the one
+/// used, the machine is restored to the snapshot of that frame and the
+/// following frames are simulated again with the corrected inputs before
+/// the next one.
+///
+/// Player k drives joystick k and paddles 2k and 2k+1; the panel switches
+/// of both players are combined. Frames are numbered from zero when the
+/// session is created, and remote inputs are accepted for the last
+/// `maxNumRollbackFrames` frames and as many ahead.
+class Atari2600RollbackSession {
+public:
+  using FrameInput = Atari2600::FrameInput;
+
+  // Lifecycle.
+  Atari2600RollbackSession(std::shared_ptr<Atari2600> machine,
+                           size_t maxNumRollbackFrames = 8, int localPlayer = 0);
+
+  // Operate.
+  void setLocalInput(FrameInput const& input) { localInput = input; }
+  void setRemoteInput(long long frameNumber, FrameInput const& input);
+  Atari2600::StoppingReason advanceFrame(
+      size_t maxNumCPUCycles = Atari2600::maxNumCPUCyclesPerFrame);
+
+  // Inspect.
+  long long getFrameNumber() const { return frameNumber; }
+  long long getLastRemoteFrameNumber() const { return lastRemoteFrameNumber; }
+  size_t getMaxNumRollbackFrames() const { return entries.size() / 2; }
+  int getLocalPlayer() const { return localPlayer; }
+  std::uint64_t getNumRollbacks() const { return numRollbacks; }
+  std::uint64_t getNumResimulatedFrames() const { return numResimulatedFrames; }
+
+protected:
+  struct Entry {
+    long long frameNumber{-1};
+    Atari2600Snapshot snapshot; /// The state at the beginning of the frame.
+    FrameInput localInput;
+    FrameInput remoteInput;     /// Valid if `received`.
+    FrameInput usedRemoteInput; /// The remote input the frame ran with.
+    bool received{false};
+  };
+
+  Entry& entryAt(long long frameNumber);
+  FrameInput const& predictRemoteInput(long long frameNumber);
+  FrameInput combine(FrameInput const& local, FrameInput const& remote) const;
+  Atari2600::StoppingReason runFrame(long long frameNumber, size_t maxNumCPUCycles);
+  void resimulate(size_t maxNumCPUCycles);
+
+  static constexpr long long noRollback = LLONG_MAX;
+
+  std::shared_ptr<Atari2600> machine;
+  int localPlayer;
+  std::vector<Entry> entries;
+  long long frameNumber;
+  long long lastRemoteFrameNumber;
+  long long rollbackFrameNumber;
+  FrameInput localInput;
+  FrameInput initialInput;
+  std::uint64_t numRollbacks;
+  std::uint64_t numResimulatedFrames;
+};
+
+} // namespace jigo
+
+#endif /* Atari2600Rollback_hpp */
@@ -0,0 +1,772 @@
+// Atari2600SelfTest.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "Atari2600SelfTest.hpp"
+#include "Atari2600.hpp"
+#include "Atari2600Benchmark.hpp"
+#include "Atari2600Rewind.hpp"
+#include "Atari2600Rollback.hpp"
+#include "TIASoundRecorder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace jigo;
+using json = nlohmann::json;
+
+// -------------------------------------------------------------------
+// MARK: - Helpers
+// -------------------------------------------------------------------
+
+/// A linear congruential generator, so that the cases are reproducible.
+struct Random {
+  explicit Random(uint32_t seed) : x(seed) {}
+  uint32_t next() {
+    x = x * 1664525u + 1013904223u;
+    return x >> 8;
+  }
+  uint32_t below(uint32_t n) { return next() % n; }
+  uint32_t x;
+};
+
+/// Count a check and, if it fails, record `message` as the reason of the
+/// failure of the case.
+static bool check(Atari2600SelfTestResult& r, bool condition, string const& message) {
+  r.numChecks++;
+  if (!condition && r.passed) {
+    r.passed = false;
+    r.message = message;
+  }
+  return condition;
+}
+
+/// Get the binary state of a machine.
+static vector<uint8_t> getBinaryState(Atari2600 const& atari) {
+  vector<uint8_t> bytes;
+  BinaryWriter w(bytes);
+  to_binary(w, atari);
+  return bytes;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Random programs
+// -------------------------------------------------------------------
+
+/// Opcodes used by the random programs, suffixed by their addressing mode.
+enum : uint8_t {
+  ADC_imm = 0x69, AND_imm = 0x29, ASL_acc = 0x0a, BIT_zp = 0x24,  BNE = 0xd0,
+  CLD = 0xd8,     DEX = 0xca,     DEY = 0x88,     EOR_zp = 0x45,  INC_zp = 0xe6,
+  JMP_abs = 0x4c, JSR_abs = 0x20, LDA_abs = 0xad, LDA_absx = 0xbd, LDA_imm = 0xa9,
+  LDA_zp = 0xa5,  LDX_imm = 0xa2, LDY_imm = 0xa0, RTS = 0x60,     SEI = 0x78,
+  STA_abs = 0x8d, STA_zp = 0x85,  STA_zpx = 0x95, TAX = 0xaa,     TAY = 0xa8,
+  TXA = 0x8a,     TXS = 0x9a
+};
+
+/// A minimal 6502 code emitter.
+struct TestProgram {
+  explicit TestProgram(uint16_t origin) : origin(origin) {}
+  uint16_t here() const { return static_cast<uint16_t>(origin + bytes.size()); }
+  void op(uint8_t opcode) { bytes.push_back(opcode); }
+  void op(uint8_t opcode, uint8_t x) { bytes.insert(bytes.end(), {opcode, x}); }
+  void op16(uint8_t opcode, uint16_t x) {
+    bytes.insert(bytes.end(),
+                 {opcode, static_cast<uint8_t>(x), static_cast<uint8_t>(x >> 8)});
+  }
+  void branch(uint8_t opcode, uint16_t target) {
+    op(opcode, static_cast<uint8_t>(target - (here() + 2)));
+  }
+  uint16_t origin;
+  vector<uint8_t> bytes;
+};
+
+/// Make a 4K ROM running a random program at every frame, after VSYNC. The
+/// program writes random values to the TIA registers at random beam
+/// positions, waits for WSYNC with the next instruction in the cartridge or
+/// in the RAM, reads the collision and input registers, accesses the RAM
+/// and the PIA, and runs delay loops, so that the TIA is
+/// left alone over spans of various lengths, with or without VBLANK. The
+/// frame number is kept at $8f, the routine `STA WSYNC; RTS` at $80, and
+/// the RAM from $90 to $ef is free for the program.
+static vector<char> makeRandomROM(uint32_t seed) {
+  Random random(seed);
+  auto randomByte = [&]() { return static_cast<uint8_t>(random.below(256)); };
+  TestProgram p(0xf000);
+  auto start = p.here();
+  p.op(SEI);
+  p.op(CLD);
+  p.op(LDX_imm, 0xff);
+  p.op(TXS);
+  p.op(LDA_imm, 0x00);
+  auto clear = p.here();
+  p.op(STA_zpx, 0x00);
+  p.op(DEX);
+  p.branch(BNE, clear);
+  uint8_t const routine[] = {STA_zp, TIA::WSYNC, RTS};
+  for (int k = 0; k < 3; ++k) {
+    p.op(LDA_imm, routine[k]);
+    p.op(STA_zp, static_cast<uint8_t>(0x80 + k));
+  }
+
+  auto frame = p.here();
+  p.op(LDA_imm, 0x02);
+  p.op(STA_zp, TIA::WSYNC);
+  p.op(STA_zp, TIA::VSYNC);
+  for (int k = 0; k < 3; ++k) {
+    p.op(STA_zp, TIA::WSYNC);
+  }
+  p.op(LDA_imm, 0x00);
+  p.op(STA_zp, TIA::VSYNC);
+  p.op(INC_zp, 0x8f);
+  int const numChunks = 40 + static_cast<int>(random.below(80));
+  for (int k = 0; k < numChunks; ++k) {
+    switch (random.below(12)) {
+    case 0:
+      p.op(LDA_imm, randomByte());
+      break;
+    case 1:
+    case 2: {
+      // Avoid VSYNC and RSYNC, which would make the frames irregular.
+      auto reg = static_cast<uint8_t>(1 + random.below(TIA::CXCLR));
+      p.op(STA_zp, reg == TIA::RSYNC ? uint8_t(TIA::VBLANK) : reg);
+      break;
+    }
+    case 3: {
+      // Write random graphics at the beginning of some scanlines, whose
+      // number depends on the frame.
+      p.op(LDA_zp, 0x8f);
+      p.op(AND_imm, 0x0f);
+      p.op(ADC_imm, static_cast<uint8_t>(1 + random.below(16)));
+      p.op(TAX);
+      auto line = p.here();
+      p.op(STA_zp, TIA::WSYNC);
+      for (int n = random.below(4); n >= 0; --n) {
+        p.op16(LDA_absx, static_cast<uint16_t>(0xfe00 + random.below(0xe0)));
+        p.op(STA_zp, static_cast<uint8_t>(TIA::NUSIZ0 + random.below(TIA::RESP0 - 4)));
+      }
+      p.op(DEX);
+      p.branch(BNE, line);
+      break;
+    }
+    case 4:
+      p.op(random.below(2) ? LDA_zp : BIT_zp, static_cast<uint8_t>(random.below(16)));
+      break;
+    case 5: {
+      uint8_t const ops[] = {STA_zp, LDA_zp, INC_zp, EOR_zp};
+      p.op(ops[random.below(4)], static_cast<uint8_t>(0x90 + random.below(0x60)));
+      break;
+    }
+    case 6:
+      if (random.below(2)) {
+        p.op16(LDA_abs, 0x0284); // INTIM
+      } else {
+        p.op(LDA_imm, randomByte());
+        p.op16(STA_abs, static_cast<uint16_t>(0x0294 + random.below(4))); // TIMxT
+      }
+      break;
+    case 7: {
+      p.op(LDY_imm, randomByte());
+      auto delay = p.here();
+      p.op(DEY);
+      p.branch(BNE, delay);
+      break;
+    }
+    case 8:
+      p.op16(LDA_absx, static_cast<uint16_t>(0xfe00 + random.below(0x100)));
+      break;
+    case 9: {
+      // Blank a few scanlines, possibly dumping the paddles, and wait for
+      // the PIA timer.
+      p.op(LDA_imm, static_cast<uint8_t>(0x02 | (randomByte() & 0xc0)));
+      p.op(STA_zp, TIA::VBLANK);
+      p.op(LDA_imm, static_cast<uint8_t>(1 + random.below(24)));
+      p.op16(STA_abs, 0x0296); // TIM64T
+      auto wait = p.here();
+      p.op16(LDA_abs, 0x0284); // INTIM
+      p.branch(BNE, wait);
+      if (random.below(2)) {
+        p.op(STA_zp, TIA::VBLANK);
+      }
+      break;
+    }
+    case 10:
+      p.op16(JSR_abs, 0x0080);
+      break;
+    default: {
+      uint8_t const ops[] = {ASL_acc, TAX, TAY, TXA};
+      p.op(ops[random.below(4)]);
+      p.op(ADC_imm, randomByte());
+      break;
+    }
+    }
+  }
+  p.op16(JMP_abs, frame);
+
+  vector<char> rom(4096, 0);
+  copy(p.bytes.begin(), p.bytes.end(), rom.begin());
+  for (int k = 0xe00; k < 0xffc; ++k) {
+    rom[k] = static_cast<char>(randomByte());
+  }
+  rom[0xffc] = static_cast<char>(start & 0xff);
+  rom[0xffd] = static_cast<char>(start >> 8);
+  return rom;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Cases
+// -------------------------------------------------------------------
+
+using Body = function<void(Atari2600SelfTestResult&)>;
+
+struct SelfTestCase {
+  string name;
+  Body body;
+};
+
+/// Capture a history past its capacity and seek to random frames in it,
+/// comparing the restored states with the ones saved at capture time. The
+/// history is small, so that it wraps around often and the oldest keyframes
+/// are dropped with the following deltas promoted to keyframes. Capturing
+/// after a seek must continue the history from the restored frame.
+static void testRewind(Atari2600SelfTestResult& r) {
+  size_t const capacity = 50;
+  auto atari = make_shared<Atari2600>();
+  auto rom = makeBenchmarkKernelROM(4096);
+  atari->setCartridge(makeCartridgeFromBytes(rom, Atari2600Cartridge::Type::S4K));
+  atari->setFastScanline(true);
+  atari->setFastCPU(true);
+  atari->setFastWSYNC(true);
+  atari->getTia()->setRenderMode(TIA::RenderMode::none);
+  Atari2600Rewind rewind(atari, capacity, 7);
+  map<long long, vector<uint8_t>> states;
+  Random random(5);
+  auto runFrame = [&]() {
+    Atari2600::FrameInput input{};
+    input.joysticks[0] = static_cast<uint8_t>(random.below(32));
+    size_t one = 1;
+    atari->runFrames(one, &input);
+    rewind.capture();
+    states[atari->getFrameNumber()] = getBinaryState(*atari);
+  };
+
+  for (size_t k = 0; k < 3 * capacity; ++k) {
+    runFrame();
+  }
+  if (!check(r, rewind.size() == capacity, "The history is not full")) return;
+  for (int k = 0; k < 200; ++k) {
+    auto first = rewind.getFirstFrameNumber();
+    auto last = rewind.getLastFrameNumber();
+    if (!check(r, last - first + 1 == static_cast<long long>(rewind.size()),
+               "The history is not contiguous")) {
+      return;
+    }
+    if (!check(r, !rewind.seek(first - 1), "Seeked before the first frame")) return;
+    if (!check(r, !rewind.seek(last + 1), "Seeked after the last frame")) return;
+
+    auto frameNumber = first + static_cast<long long>(random.below(
+                                   static_cast<uint32_t>(last - first + 1)));
+    ostringstream message;
+    message << "Frame " << frameNumber << " of [" << first << ", " << last << "]";
+    bool found;
+    try {
+      found = rewind.seek(frameNumber);
+    } catch (exception const& e) {
+      check(r, false, message.str() + " not decoded: " + e.what());
+      return;
+    }
+    if (!check(r, found, message.str() + " not found")) return;
+    if (!check(r, getBinaryState(*atari) == states[frameNumber],
+               message.str() + " restored wrongly")) {
+      return;
+    }
+
+    // Resume the history from the restored frame most of the time.
+    if (random.below(4) != 0) {
+      states.erase(states.upper_bound(frameNumber), states.end());
+      auto numFrames = 1 + random.below(k % 50 == 0 ? 2 * capacity : 6);
+      for (uint32_t n = 0; n < numFrames; ++n) {
+        runFrame();
+      }
+      if (!check(r, rewind.getLastFrameNumber() == frameNumber + numFrames,
+                 message.str() + " not resumed by capture()")) {
+        return;
+      }
+    }
+  }
+}
+
+/// Options of the simulation loop.
+struct EngineOptions {
+  bool fastScanline;
+  bool fastCPU;
+  bool fastWSYNC;
+  bool staticCartridgeDispatch;
+};
+
+static string to_string(EngineOptions const& options) {
+  string str;
+  if (options.fastScanline) str += "+fastScanline";
+  if (options.fastCPU) str += "+fastCPU";
+  if (options.fastWSYNC) str += "+fastWSYNC";
+  if (options.staticCartridgeDispatch) str += "+staticCartridgeDispatch";
+  return str.empty() ? "exact" : str.substr(1);
+}
+
+/// Run `rom` for `numFrames` frames in each render mode, with one machine
+/// for each of `options` and a reference machine using the exact engine.
+/// The render mode only matters to the fast scanline engine, so the other
+/// combinations run in the full mode only. Paddles are connected, so that
+/// their capacitors charge. After each
+/// frame, the state and the screens of each machine are compared with the
+/// ones of the reference at the same CPU cycle. The fast CPU engine stops
+/// at an instruction boundary, possibly a few cycles after the end of the
+/// frame, so the reference is brought to the same cycle.
+static bool compareEngines(Atari2600SelfTestResult& r, string const& name,
+                           vector<char> const& rom, Atari2600Cartridge::Type type,
+                           vector<EngineOptions> const& options, int numFrames) {
+  TIA::RenderMode const renderModes[] = {TIA::RenderMode::full, TIA::RenderMode::indexed,
+                                         TIA::RenderMode::collisionsOnly,
+                                         TIA::RenderMode::none};
+  char const* const renderModeNames[] = {"full", "indexed", "collisionsOnly", "none"};
+  size_t const screenSize = TIA::screenWidth * TIA::screenHeight;
+  for (int mode = 0; mode < 4; ++mode) {
+    auto makeMachine = [&](EngineOptions const& o) {
+      auto atari = make_shared<Atari2600>();
+      atari->setCartridge(makeCartridgeFromBytes(rom, type));
+      atari->setFastScanline(o.fastScanline);
+      atari->setFastCPU(o.fastCPU);
+      atari->setFastWSYNC(o.fastWSYNC);
+      atari->setStaticCartridgeDispatch(o.staticCartridgeDispatch);
+      atari->getTia()->setRenderMode(renderModes[mode]);
+      for (int k = 0; k < 4; ++k) {
+        atari->setPaddle(k, Atari2600::Paddle(false, -120.0f + 40.0f * k));
+      }
+      return atari;
+    };
+    auto reference = makeMachine(EngineOptions{});
+    vector<shared_ptr<Atari2600>> machines;
+    vector<EngineOptions> machineOptions;
+    for (auto const& o : options) {
+      if (o.fastScanline || renderModes[mode] == TIA::RenderMode::full) {
+        machines.push_back(makeMachine(o));
+        machineOptions.push_back(o);
+      }
+    }
+
+    for (int f = 0; f < numFrames; ++f) {
+      for (auto& atari : machines) {
+        size_t one = 1;
+        atari->runFrames(one);
+      }
+      vector<size_t> order(machines.size());
+      for (size_t k = 0; k < order.size(); ++k) {
+        order[k] = k;
+      }
+      auto numCycles = [&](size_t k) { return machines[k]->getCpu()->getNumCycles(); };
+      sort(order.begin(), order.end(),
+           [&](size_t a, size_t b) { return numCycles(a) < numCycles(b); });
+      for (auto k : order) {
+        auto const& atari = *machines[k];
+        auto target = atari.getCpu()->getNumCycles();
+        while (reference->getCpu()->getNumCycles() < target) {
+          size_t numCycles = target - reference->getCpu()->getNumCycles();
+          reference->cycle(numCycles);
+        }
+        ostringstream where;
+        where << name << " with " << to_string(machineOptions[k]) << " in the "
+              << renderModeNames[mode] << " render mode at frame " << f;
+        if (!check(r, reference->getCpu()->getNumCycles() == target,
+                   where.str() + ": the exact engine overran the cycle count")) {
+          return false;
+        }
+        if (!check(r, getBinaryState(atari) == getBinaryState(*reference),
+                   where.str() + ": the state differs from the exact engine")) {
+          return false;
+        }
+        auto tia = atari.getTia();
+        auto referenceTia = reference->getTia();
+        bool sameScreen = equal(tia->getLastScreen(), tia->getLastScreen() + screenSize,
+                                referenceTia->getLastScreen()) &&
+                          equal(tia->getLastIndexedScreen(),
+                                tia->getLastIndexedScreen() + screenSize,
+                                referenceTia->getLastIndexedScreen());
+        if (!check(r, sameScreen,
+                   where.str() + ": the screen differs from the exact engine")) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/// Compare each combination of the fast engines with the exact one frame by
+/// frame on the benchmark kernels and on random programs.
+static void testFastEngines(Atari2600SelfTestResult& r) {
+  vector<EngineOptions> options;
+  for (int k = 1; k < 16; ++k) {
+    options.push_back({bool(k & 1), bool(k & 2), bool(k & 4), bool(k & 8)});
+  }
+  struct Kernel {
+    char const* name;
+    Atari2600Cartridge::Type type;
+    size_t size;
+    int minBankStrobe;
+    bool superchip;
+  };
+  Kernel const kernels[] = {
+      {"playfield4K", Atari2600Cartridge::Type::S4K, 4096, 0, false},
+      {"bankswitch8K", Atari2600Cartridge::Type::S8K, 8192, 0xff8, false},
+      {"superchip16K", Atari2600Cartridge::Type::S16K128R, 16384, 0xff6, true},
+  };
+  for (auto const& k : kernels) {
+    auto rom = makeBenchmarkKernelROM(k.size, k.minBankStrobe, k.superchip);
+    if (!compareEngines(r, k.name, rom, k.type, options, 6)) return;
+  }
+  for (uint32_t seed = 1; seed <= 16; ++seed) {
+    auto name = "the random program " + std::to_string(seed);
+    auto rom = makeRandomROM(seed);
+    if (!compareEngines(r, name, rom, Atari2600Cartridge::Type::S4K, options, 4)) return;
+  }
+}
+
+/// A flat 64K memory for the CPU alone, filled with random bytes, whose
+/// RDY, IRQ, NMI and reset lines are driven at random. The lines follow
+/// the same sequence for the same sequence of bus cycles, so that two CPUs
+/// see the same inputs. The accesses are recorded. The opcodes KIL, which
+/// jam the CPU, are read as NOP.
+struct RandomBus final : M6502Bus {
+  struct Access {
+    uint16_t address;
+    bool RW;
+    uint8_t data;
+    bool ready;
+    bool operator==(Access const& a) const {
+      return address == a.address && RW == a.RW && data == a.data && ready == a.ready;
+    }
+  };
+
+  explicit RandomBus(uint32_t seed)
+   : random(seed), numStalledCycles(0), numNMICycles(0), ready(true) {
+    for (auto& x : memory) {
+      x = static_cast<uint8_t>(random.below(256));
+    }
+  }
+
+  void cycle(M6502& cpu) override {
+    auto address = cpu.getAddressBus();
+    if (cpu.getRW()) {
+      auto data = memory[address];
+      cpu.setDataBus(M6502::decode(data).instructionType == M6502::KIL ? 0xea : data);
+    } else {
+      memory[address] = cpu.getDataBus();
+    }
+    accesses.push_back({address, cpu.getRW(), cpu.getDataBus(), ready});
+
+    // Drive the lines for the next cycle.
+    auto x = random.below(1000);
+    if (numStalledCycles > 0) {
+      numStalledCycles--;
+    } else if (x < 20) {
+      numStalledCycles = 1 + random.below(12);
+    }
+    ready = (numStalledCycles == 0);
+    if (20 <= x && x < 25) {
+      cpu.setIRQLine(!cpu.getIRQLine());
+    }
+    if (numNMICycles > 0) {
+      if (--numNMICycles == 0) cpu.setNMILine(false);
+    } else if (x == 25) {
+      numNMICycles = 1 + random.below(16);
+      cpu.setNMILine(true);
+    }
+    if (x == 26 && random.below(8) == 0) {
+      cpu.setResetLine(true);
+    }
+  }
+
+  bool isReady() const override { return ready; }
+
+  Random random;
+  array<uint8_t, 0x10000> memory;
+  vector<Access> accesses;
+  uint32_t numStalledCycles;
+  uint32_t numNMICycles;
+  bool ready;
+};
+
+/// Compare `M6502::step()` with the equivalent calls to `cycle()` on random
+/// programs, including the undocumented instructions, the decimal mode,
+/// the stalls caused by RDY, the interrupts and the resets. After each
+/// instruction, the state of the CPUs and the bus accesses made during the
+/// instruction must be the same.
+static void testCPUStep(Atari2600SelfTestResult& r) {
+  for (uint32_t seed = 1; seed <= 32; ++seed) {
+    M6502 stepped;
+    M6502 cycled;
+    RandomBus steppedBus(seed);
+    RandomBus cycledBus(seed);
+    for (int k = 0; k < 4000; ++k) {
+      stepped.step(steppedBus);
+      while (cycled.getNumCycles() < stepped.getNumCycles()) {
+        cycled.cycle(cycledBus.isReady());
+        cycledBus.cycle(cycled);
+      }
+      ostringstream where;
+      where << "With the random program " << seed << ", step " << k << " at cycle "
+            << stepped.getNumCycles() << " (instruction $" << hex
+            << int(stepped.getIR()) << " at $" << stepped.getPCIR() << ")";
+      if (!check(r, steppedBus.accesses == cycledBus.accesses,
+                 where.str() + ": the bus accesses differ from cycle()")) {
+        return;
+      }
+      if (!check(r, static_cast<M6502State const&>(stepped) == cycled,
+                 where.str() + ": the state differs from cycle()")) {
+        return;
+      }
+      steppedBus.accesses.clear();
+      cycledBus.accesses.clear();
+    }
+  }
+}
+
+/// Compare `M6532::advance(n)` with n calls to `cycle()` with the chip not
+/// selected from random timer states. These cover every interval, prescaler
+/// counters close to wrapping around, the underflow of INTIM, and the
+/// decrement to 0x80 after the interrupt.
+static void testPIAAdvance(Atari2600SelfTestResult& r) {
+  int const intervals[] = {1, 8, 64, 1024};
+  Random random(15);
+  for (int k = 0; k < 5000; ++k) {
+    M6532 stepped;
+    stepped.timerInterval = intervals[random.below(4)];
+    stepped.timerCounter = random.next();
+    if (random.below(4) == 0) {
+      stepped.timerCounter = -static_cast<int unsigned>(random.below(2048));
+    }
+    stepped.INTIM = static_cast<uint8_t>(random.below(256));
+    stepped.timerInterrupt = random.below(2);
+    size_t numCycles;
+    switch (random.below(4)) {
+    case 0: numCycles = random.below(16); break;
+    case 1: numCycles = random.below(1024); break;
+    case 2: numCycles = random.below(4 * 256 * stepped.timerInterval + 1); break;
+    default: numCycles = random.below(k < 50 ? 400000 : 4096); break;
+    }
+    M6532State const initial = stepped;
+    M6532 advanced;
+    advanced = initial;
+    uint8_t data = 0;
+    for (size_t n = 0; n < numCycles; ++n) {
+      stepped.cycle(false, false, true, 0x1000, data);
+    }
+    advanced.advance(numCycles);
+    if (!(static_cast<M6532State const&>(advanced) == stepped)) {
+      ostringstream message;
+      message << "advance(" << numCycles << ") differs from single steps from the state "
+              << json(initial).dump();
+      check(r, false, message.str());
+      return;
+    }
+    check(r, true, "");
+  }
+}
+
+/// Record a program that plays a tone on both channels without ever ending
+/// a frame. The recorder is then only updated by the TIA when the sound
+/// queues fill up, and must still produce the same samples as when it is
+/// updated at every frame-long interval.
+static void testSoundRecorderWithoutVSYNC(Atari2600SelfTestResult& r) {
+  uint8_t const program[] = {
+      0x78, 0xd8,       // SEI, CLD
+      0xa9, 0x04,       // LDA #$04
+      0x85, TIA::AUDC0, // STA AUDC0
+      0x85, TIA::AUDC1, // STA AUDC1
+      0xa9, 0x00,       // LDA #$00
+      0x85, TIA::AUDF0, // STA AUDF0
+      0xa9, 0x03,       // LDA #$03
+      0x85, TIA::AUDF1, // STA AUDF1
+      0xa9, 0x0f,       // LDA #$0F
+      0x85, TIA::AUDV0, // STA AUDV0
+      0x85, TIA::AUDV1, // STA AUDV1
+      0x4c, 0x16, 0xf0, // JMP *
+  };
+  vector<char> rom(4096, 0);
+  copy(begin(program), end(program), rom.begin());
+  rom[0xffd] = static_cast<char>(0xf0);
+
+  size_t const frameLength = 262 * 76;
+  size_t const numFrames = 120;
+  vector<uint8_t> recordings[2];
+  long long numSamples[2];
+  for (int updated = 0; updated < 2; ++updated) {
+    Atari2600 atari;
+    atari.setCartridge(makeCartridgeFromBytes(rom, Atari2600Cartridge::Type::S4K));
+    auto tia = atari.getTia();
+    TIASoundRecorder recorder(44100, 3.579545e6);
+    tia->setSoundRecorder(&recorder);
+    for (size_t k = 0; k < numFrames; ++k) {
+      size_t numCycles = frameLength;
+      atari.cycle(numCycles);
+      if (updated) {
+        recorder.update(tia->getSound(0), tia->getSound(1));
+      }
+    }
+    recorder.update(tia->getSound(0), tia->getSound(1));
+    tia->setSoundRecorder(nullptr);
+    recordings[updated] = recorder.take();
+    numSamples[updated] = recorder.getNumSamples();
+    if (!check(r, atari.getFrameNumber() == 0, "The program ended a frame")) return;
+    if (!check(r, recorder.getNumOverflows() == 0, "The sound queues overflowed")) return;
+    auto expected = static_cast<long long>(tia->getSound(0).getStreamTime() * 44100 /
+                                           3.579545e6);
+    ostringstream message;
+    message << "Recorded " << numSamples[updated] << " samples instead of about "
+            << expected;
+    if (!check(r, abs(numSamples[updated] - expected) <= 1, message.str())) return;
+  }
+  check(r, recordings[0] == recordings[1],
+        "The samples depend on the interval between the recorder updates");
+}
+
+/// Check that a session yields the same state and picture as a plain run
+/// with the inputs of both players known in advance. The remote inputs
+/// arrive `delay` frames late, so that the session rolls back whenever the
+/// remote joystick changes. The first input is corrected late, within the
+/// first frames of the session, and out-of-window inputs are rejected.
+static void testRollbackSession(Atari2600SelfTestResult& r) {
+  size_t const maxNumRollbackFrames = 3;
+  long long const delay = 2;
+  long long const numFrames = 120;
+  auto rom = makeBenchmarkKernelROM(4096);
+  auto makeMachine = [&]() {
+    auto atari = make_shared<Atari2600>();
+    atari->setCartridge(makeCartridgeFromBytes(rom, Atari2600Cartridge::Type::S4K));
+    atari->setFastScanline(true);
+    atari->setFastWSYNC(true);
+    return atari;
+  };
+  auto makeInput = [](long long frameNumber, int player) {
+    Atari2600::FrameInput input{};
+    auto x = static_cast<uint8_t>((frameNumber * (player ? 7 : 3)) / 11);
+    input.joysticks[player] = x & 0x1f;
+    return input;
+  };
+  auto reference = makeMachine();
+  auto atari = makeMachine();
+  Atari2600RollbackSession session(atari, maxNumRollbackFrames, 0);
+
+  auto rejects = [&](long long frameNumber) {
+    try {
+      session.setRemoteInput(frameNumber, makeInput(frameNumber, 1));
+    } catch (invalid_argument const&) {
+      return true;
+    }
+    return false;
+  };
+  if (!check(r, rejects(-1), "Accepted an input for frame -1")) return;
+  if (!check(r, rejects(maxNumRollbackFrames), "Accepted an input too far ahead")) return;
+
+  // At frame 1, the remote input for frame 3 arrives early and the one for
+  // frame 0 arrives late, first wrong and then corrected. An input for
+  // frame -1, which would share the slot of frame 3, must be rejected.
+  for (long long f = 0; f < numFrames; ++f) {
+    auto input = makeInput(f, 0);
+    input.joysticks[1] = makeInput(f, 1).joysticks[1];
+    size_t one = 1;
+    reference->runFrames(one, &input);
+
+    if (f == 1) {
+      session.setRemoteInput(3, makeInput(3, 1));
+      auto wrong = makeInput(0, 1);
+      wrong.joysticks[1] ^= 0x1f;
+      session.setRemoteInput(0, wrong);
+      if (!check(r, rejects(-1), "Accepted an input for frame -1 at frame 1")) return;
+      session.setRemoteInput(0, makeInput(0, 1));
+    }
+    if (f >= delay && f - delay != 0 && f - delay != 3) {
+      session.setRemoteInput(f - delay, makeInput(f - delay, 1));
+    }
+    session.setLocalInput(makeInput(f, 0));
+    try {
+      session.advanceFrame();
+    } catch (exception const& e) {
+      check(r, false, string("advanceFrame() failed: ") + e.what());
+      return;
+    }
+  }
+
+  // Deliver the last inputs and run one more frame to apply them.
+  for (long long f = numFrames - delay; f <= numFrames; ++f) {
+    session.setRemoteInput(f, makeInput(f, 1));
+  }
+  auto input = makeInput(numFrames, 0);
+  input.joysticks[1] = makeInput(numFrames, 1).joysticks[1];
+  size_t one = 1;
+  reference->runFrames(one, &input);
+  session.setLocalInput(makeInput(numFrames, 0));
+  session.advanceFrame();
+
+  if (!check(r, session.getNumRollbacks() > 0, "The session never rolled back")) return;
+  if (!check(r, getBinaryState(*atari) == getBinaryState(*reference),
+             "The state differs from a run with the inputs known in advance")) {
+    return;
+  }
+  size_t const screenSize = TIA::screenWidth * TIA::screenHeight;
+  auto screen = atari->getTia()->getLastScreen();
+  check(r, equal(screen, screen + screenSize, reference->getTia()->getLastScreen()),
+        "The picture differs from a run with the inputs known in advance");
+}
+
+static vector<SelfTestCase> makeCases() {
+  return {
+      {"Atari2600Rewind", testRewind},
+      {"Atari2600.fastEngines", testFastEngines},
+      {"M6502.step", testCPUStep},
+      {"M6532.advance", testPIAAdvance},
+      {"TIASoundRecorder.withoutVSYNC", testSoundRecorderWithoutVSYNC},
+      {"Atari2600RollbackSession", testRollbackSession},
+  };
+}
+
+// -------------------------------------------------------------------
+// MARK: - Run
+// -------------------------------------------------------------------
+
+/// Get the names of the self-test cases.
+vector<string> jigo::getAtari2600SelfTestNames() {
+  vector<string> names;
+  for (auto const& c : makeCases()) {
+    names.push_back(c.name);
+  }
+  return names;
+}
+
+/// Run the self-test cases whose name contains `filter`.
+vector<Atari2600SelfTestResult> jigo::runAtari2600SelfTests(string const& filter) {
+  vector<Atari2600SelfTestResult> results;
+  for (auto const& c : makeCases()) {
+    if (c.name.find(filter) == string::npos) continue;
+    Atari2600SelfTestResult result{c.name, true, 0, ""};
+    c.body(result);
+    results.push_back(result);
+  }
+  return results;
+}
+
+void jigo::to_json(json& j, Atari2600SelfTestResult const& result) {
+  j = json{
+      {"name", result.name}, {"passed", result.passed}, {"numChecks", result.numChecks}};
+  if (!result.passed) {
+    j["message"] = result.message;
+  }
+}
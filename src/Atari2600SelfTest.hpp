@@ -0,0 +1,40 @@
+// Atari2600SelfTest.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600SelfTest_hpp
+#define Atari2600SelfTest_hpp
+
+#include "json.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Self tests
+// -----------------------------------------------------------------
+
+/// The outcome of a self-test case. A case makes a number of checks and
+/// stops at the first one that fails, which is described by `message`.
+struct Atari2600SelfTestResult {
+  std::string name;
+  bool passed;
+  std::uint64_t numChecks;
+  std::string message;
+};
+
+std::vector<std::string> getAtari2600SelfTestNames();
+std::vector<Atari2600SelfTestResult>
+runAtari2600SelfTests(std::string const& filter = "");
+
+void to_json(nlohmann::json& j, Atari2600SelfTestResult const& result);
+
+} // namespace jigo
+
+#endif /* Atari2600SelfTest_hpp */
@@ -0,0 +1,296 @@
+// Atari2600Simulation.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600Simulation_hpp
+#define Atari2600Simulation_hpp
+
+#include "Atari2600.hpp"
+#include "Atari2600Profiler.hpp"
+#include "Atari2600Trace.hpp"
+
+#include <algorithm>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Simulation loop
+// -----------------------------------------------------------------
+
+// The simulation loop is a template on the cartridge class. It is
+// instantiated once for each concrete (final) cartridge class, so that the
+// compiler can resolve and inline the cartridge logic in the loop, and once
+// for the `Atari2600Cartridge` interface, which dispatches virtually.
+
+/// The system bus as seen by the CPU. Completing a bus cycle steps the PIA,
+/// the TIA and the cartridge, which answer the access placed on the bus by
+/// the CPU, and checks the breakpoints and the watchpoints.
+template <class Cartridge> struct Atari2600::CPUBus final : M6502Bus {
+  CPUBus(Atari2600& atari, Cartridge* cart)
+   : atari(atari), pia(*atari.getPia()), tia(*atari.getTia()), cart(cart),
+     numPendingTIACycles(0), numPendingPIACycles(0) {}
+
+  bool isReady() const override { return tia.RDY; }
+
+  void cycle(M6502& cpu) override {
+    auto da = DecodedAddress(cpu.getAddressBus(), cpu.getRW());
+    bool stalled = !tia.RDY && cpu.getRW();
+
+    // Step the PIA. The cycles in which the CPU does not access the PIA only
+    // advance its timer, so they are accumulated and simulated in closed
+    // form when it does.
+    bool oututPortsChanged = false;
+    if (da.device == DecodedAddress::PIA) {
+      pia.advance(numPendingPIACycles);
+      numPendingPIACycles = 0;
+      oututPortsChanged = pia.cycle(true, cpu.getAddressBus() & 0x200, cpu.getRW(),
+                                    cpu.getAddressBus(), cpu.getDataBus());
+    } else {
+      numPendingPIACycles++;
+    }
+
+    if (oututPortsChanged) {
+      tia.advance(numPendingTIACycles);
+      numPendingTIACycles = 0;
+      atari.syncPorts();
+    }
+
+    // Step the TIA. With the fast scanline engine, the cycles in which the
+    // CPU does not access the TIA are accumulated and simulated in bulk when
+    // it does. This requires RDY to be high, as the CPU samples it at every
+    // cycle, and no strobe to be pending, as the latter may lower RDY.
+    bool tiaSelected = (da.device == DecodedAddress::TIA);
+    if (atari.fastScanline && !tiaSelected && tia.RDY && tia.strobe == TIA::VOID) {
+      numPendingTIACycles++;
+    } else {
+      tia.advance(numPendingTIACycles);
+      numPendingTIACycles = 0;
+      tia.cycle(tiaSelected, cpu.getRW(), cpu.getAddressBus(), cpu.getDataBus());
+    }
+
+    // Step the cartridge. The cartridge must be updated last
+    // as some rare cart types (FE banking) "sniff"
+    // the data bus to work, and the latter must be up to date.
+    if (cart) {
+      cart->cycle(atari, da.device == DecodedAddress::Cartridge);
+    }
+
+    // Record the bus cycle. The TIA is brought up to date so that the beam
+    // position is exact.
+    if (atari.traceRecorder) {
+      tia.advance(numPendingTIACycles);
+      numPendingTIACycles = 0;
+      atari.traceRecorder->record(cpu, tia);
+    }
+
+    if (atari.profiler) {
+      profile(cpu, 1, stalled, tia.beamX + 3 * static_cast<int>(numPendingTIACycles));
+    }
+
+    if (atari.debugging) {
+      checkDebugPoints(cpu, da);
+    }
+  }
+
+  /// Simulate the cycles in which the CPU is stalled by WSYNC, up to
+  /// `maxNumCycles`, and return their number. While stalled, the CPU repeats
+  /// the same read until the TIA raises RDY, so the number of such cycles is
+  /// known in advance. The PIA timer and the TIA are then advanced in bulk,
+  /// the latter using the fast scanline engine if enabled. The cartridge sees
+  /// the same access in each cycle and is still stepped one cycle at a time,
+  /// which is cheap; reads with side effects on the TIA and the PIA I/O
+  /// registers, as well as all the cycles when tracing, are left to
+  /// `cycle()`, and zero is returned.
+  size_t cycleStalled(M6502& cpu, size_t maxNumCycles) {
+    auto da = DecodedAddress(cpu.getAddressBus(), cpu.getRW());
+    bool piaSelected = (da.device == DecodedAddress::PIA);
+    if (da.device == DecodedAddress::TIA ||
+        (piaSelected && (cpu.getAddressBus() & 0x200)) || atari.traceRecorder) {
+      return 0;
+    }
+    size_t n = std::min(tia.getNumCyclesToReady(), maxNumCycles);
+
+    // Profile the cycles, which end three color clocks apart.
+    if (atari.profiler) {
+      profile(cpu, n, true, tia.beamX + 3 * static_cast<int>(numPendingTIACycles + 1));
+    }
+
+    // Step the PIA. Repeated RAM reads return the same data.
+    if (piaSelected) {
+      pia.advance(numPendingPIACycles + n - 1);
+      numPendingPIACycles = 0;
+      pia.cycle(true, false, true, cpu.getAddressBus(), cpu.getDataBus());
+    } else {
+      numPendingPIACycles += n;
+    }
+
+    // Step the TIA.
+    tia.advance(numPendingTIACycles);
+    numPendingTIACycles = 0;
+    if (atari.fastScanline) {
+      tia.advance(n);
+    } else {
+      for (size_t k = 0; k < n; ++k) {
+        tia.cycle(false, true, cpu.getAddressBus(), cpu.getDataBus());
+      }
+    }
+
+    // Step the cartridge, which may bank switch or sniff the data bus.
+    if (cart) {
+      for (size_t k = 0; k < n; ++k) {
+        cart->cycle(atari, da.device == DecodedAddress::Cartridge);
+      }
+    }
+
+    cpu.setNumCycles(cpu.getNumCycles() + n);
+    if (atari.debugging) {
+      checkDebugPoints(cpu, da);
+    }
+    return n;
+  }
+
+  /// Charge `n` cycles to the current instruction, the first ending at the
+  /// color clock `beamX` of the current line of the TIA, which can exceed
+  /// the line length. A new instruction begins at T1, after its opcode
+  /// fetch. With the fast scanline engine, the beam position is extrapolated
+  /// from the last TIA update, which is exact except for the few cycles in
+  /// which a RSYNC strobe takes effect.
+  void profile(M6502 const& cpu, size_t n, bool stalled, int beamX) {
+    if (cpu.getT() == 1 && !stalled) {
+      std::uint32_t virtualAddress = cpu.getPCIR() & 0x1fff;
+      if ((virtualAddress & 0x1000) && cart) {
+        virtualAddress = cart->decodeAddress(cpu.getPCIR());
+      }
+      atari.profiler->beginInstruction(virtualAddress);
+    }
+    atari.profiler->addCycles(n, stalled, beamX, tia.beamY);
+  }
+
+  void checkDebugPoints(M6502 const& cpu, DecodedAddress const& da) {
+    // T=0 means that the CPU has put on the address bus the
+    // address of the next instruction opcode. Note, however,
+    // that the *previous* instruction is still finishing during this
+    // cycle, so cpu.PCForCurrentInstruction() is still the old one
+    // and registers are still not updated with the new data.
+    //
+    // Hence, a breakpoint hit only stops the simulation after the *next*
+    // cycle is executed, and its condition is evaluated then.
+    if (cpu.getT() == 0) {
+      std::uint32_t virtualAddress = da.address;
+      if (da.device == DecodedAddress::Cartridge && cart) {
+        virtualAddress = cart->decodeAddress(virtualAddress);
+      }
+      auto word = virtualAddress >> 6;
+      if (word < atari.breakPointBits.size() &&
+          ((atari.breakPointBits[word] >> (virtualAddress & 63)) & 1)) {
+        auto const& bp = atari.breakPoints.find(virtualAddress)->second;
+        if (bp.temporary) {
+          // Clear the breakpoint if temporary.
+          atari.clearBreakPoint(virtualAddress, true);
+          atari.breakCondition = Atari2600Condition();
+          atari.breakOnNextInstruction = true;
+        } else if (!atari.breakOnNextInstruction) {
+          atari.breakCondition = bp.condition;
+          atari.breakOnNextInstruction = true;
+        }
+      }
+    }
+
+    // Watchpoints are checked at the end of the access, when the data bus
+    // holds the data read or written.
+    if (da.device != DecodedAddress::Cartridge) {
+      bool write = !cpu.getRW();
+      auto address = cpu.getAddressBus();
+      auto key = atari.watchKey(atari.canonicalizeAddress(address, !write), write);
+      if (atari.watchPointBits[key]) {
+        auto const& wp = atari.watchPoints.find(key)->second;
+        if (atari.evaluate(wp.condition, cpu.getDataBus())) {
+          atari.lastWatchPointHit = {cpu.getNumCycles(), address, cpu.getDataBus(),
+                                     write};
+          atari.watchPointHit = true;
+          atari.breakOnNextInstruction = true;
+        }
+      }
+    }
+  }
+
+  Atari2600& atari;
+  M6532& pia;
+  TIA& tia;
+  Cartridge* cart;
+  size_t numPendingTIACycles;
+  size_t numPendingPIACycles;
+};
+
+/// Implement `Atari2600::cycle()` for the cartridge class `Cartridge`.
+template <class Cartridge>
+Atari2600::StoppingReason Atari2600::cycleWithCartridge(size_t& maxNumCPUCycles) {
+  // Handle inputs.
+  syncPorts();
+
+  // Simulate cycles.
+  StoppingReason reason;
+  auto _cpu = getCpu();
+  auto _tia = getTia();
+  CPUBus<Cartridge> bus(*this, static_cast<Cartridge*>(concreteCartridge));
+
+  // If no cycles should be simulated, make sure we stop immediately.
+  reason.set(StoppingReason::numCyclesReached, maxNumCPUCycles == 0);
+
+  // Loop until one of the stopping reasons is met.
+  while (!reason.any()) {
+    // Remember the current frame in order to detect the beginning of a new
+    // one.
+    auto lastFrame = _tia->numFrames;
+
+    // Step the CPU and the devices on the bus. The CPU is stalled if RDY
+    // was low during its last read.
+    size_t numStalledCycles = 0;
+    if (fastWSYNC && !_tia->RDY && _cpu->getRW()) {
+      numStalledCycles = bus.cycleStalled(*_cpu, maxNumCPUCycles);
+    }
+    if (numStalledCycles > 0) {
+      maxNumCPUCycles -= numStalledCycles;
+    } else if (fastCPU && !breakOnNextInstruction && _cpu->isAtInstructionBoundary()) {
+      maxNumCPUCycles -= std::min(_cpu->step(bus), maxNumCPUCycles);
+    } else {
+      _cpu->cycle(_tia->RDY);
+      bus.cycle(*_cpu);
+      maxNumCPUCycles--;
+    }
+
+    // Check if the maximum number of CPU clocks have been simulated.
+    reason.set(StoppingReason::numCyclesReached, maxNumCPUCycles == 0);
+
+    // Check if a new frame has started.
+    if (_tia->numFrames > lastFrame) {
+      reason.set(StoppingReason::frameDone);
+    }
+
+    // Check if a breakpoint or a watchpoint was hit.
+    if ((_cpu->getT() == 1) && _tia->RDY && breakOnNextInstruction) {
+      // T=1 means that the CPU is executing the first cycle of a
+      // new instruction. At this point, the CPU registers
+      // are already updated with the *input* to that instruction,
+      // including cpu.PCForCurrentInstruction().
+      if (watchPointHit) {
+        reason.set(StoppingReason::watchpoint);
+      } else if (evaluate(breakCondition)) {
+        reason.set(StoppingReason::breakpoint);
+      }
+      breakOnNextInstruction = false;
+      watchPointHit = false;
+      breakCondition = Atari2600Condition();
+    }
+  }
+  _tia->advance(bus.numPendingTIACycles);
+  getPia()->advance(bus.numPendingPIACycles);
+  return reason;
+}
+
+} // namespace jigo
+
+#endif /* Atari2600Simulation_hpp */
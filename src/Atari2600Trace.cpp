@@ -0,0 +1,174 @@
+// Atari2600Trace.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "Atari2600Trace.hpp"
+#include "Atari2600.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace jigo;
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+/// Create a recorder with a ring buffer of at least `capacity` records.
+Atari2600TraceRecorder::Atari2600TraceRecorder(size_t capacity) {
+  size_t n = 1;
+  while (n < capacity) {
+    n <<= 1;
+  }
+  ring.resize(n);
+  mask = n - 1;
+}
+
+Atari2600TraceRecorder::~Atari2600TraceRecorder() {
+  close();
+}
+
+// -------------------------------------------------------------------
+// MARK: - Produce
+// -------------------------------------------------------------------
+
+/// Push a record into a full buffer.
+void Atari2600TraceRecorder::push(Atari2600TraceRecord const& record) {
+  auto h = head.load(std::memory_order_relaxed);
+  while (h - tail.load(std::memory_order_acquire) > mask) {
+    if (!flushing.load(std::memory_order_relaxed)) {
+      ++numDropped;
+      return;
+    }
+    this_thread::yield();
+  }
+  ring[h & mask] = record;
+  head.store(h + 1, std::memory_order_release);
+  ++numRecords;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Consume
+// -------------------------------------------------------------------
+
+/// Start writing the records to the file at `path`, truncating it, from a
+/// background thread. Throws `std::runtime_error` if the file cannot be
+/// opened.
+void Atari2600TraceRecorder::open(string const& path) {
+  close();
+  file.open(path, ios::binary | ios::trunc);
+  if (!file) {
+    throw runtime_error("Cannot open the trace file " + path);
+  }
+  flushing = true;
+  flusher = thread(&Atari2600TraceRecorder::flush, this);
+}
+
+/// Write the remaining records and close the file, if any.
+void Atari2600TraceRecorder::close() {
+  if (!isOpen()) return;
+  flushing = false;
+  flusher.join();
+  file.close();
+}
+
+/// Move up to `maxNumRecords` of the oldest records to `records` and
+/// return their number. This must not be called while a file is open.
+size_t Atari2600TraceRecorder::drain(Atari2600TraceRecord* records,
+                                     size_t maxNumRecords) {
+  assert(!isOpen());
+  auto t = tail.load(std::memory_order_relaxed);
+  auto n = min(head.load(std::memory_order_acquire) - t, maxNumRecords);
+  for (size_t k = 0; k < n; ++k) {
+    records[k] = ring[(t + k) & mask];
+  }
+  tail.store(t + n, std::memory_order_release);
+  return n;
+}
+
+size_t Atari2600TraceRecorder::size() const {
+  return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+/// The body of the flusher thread. The records are written in contiguous
+/// runs straight from the ring buffer.
+void Atari2600TraceRecorder::flush() {
+  while (true) {
+    // Read the flag before the head, so that the last records are written
+    // after `close()`.
+    bool last = !flushing.load(std::memory_order_acquire);
+    auto t = tail.load(std::memory_order_relaxed);
+    auto h = head.load(std::memory_order_acquire);
+    while (t != h) {
+      auto n = min(h - t, ring.size() - (t & mask));
+      file.write(reinterpret_cast<char const*>(&ring[t & mask]),
+                 n * sizeof(Atari2600TraceRecord));
+      t += n;
+      tail.store(t, std::memory_order_release);
+    }
+    if (last) break;
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  file.flush();
+}
+
+// -------------------------------------------------------------------
+// MARK: - Decode
+// -------------------------------------------------------------------
+
+/// Print the first `numPrinted` of `numRecords` records, one per line. The
+/// opcode fetches are followed by the disassembled instruction, which is
+/// decoded from the next records; the records after the first `numPrinted`
+/// are only used for this purpose. Stalled cycles (with RDY
+/// low) are marked with `*`.
+void jigo::printTrace(ostream& os, Atari2600TraceRecord const* records, size_t numRecords,
+                      size_t numPrinted) {
+  numPrinted = min(numPrinted, numRecords);
+  for (size_t k = 0; k < numPrinted; ++k) {
+    auto const& r = records[k];
+    auto da = Atari2600::DecodedAddress(r.address, r.getRW());
+    os << dec << setfill(' ') << setw(10) << r.cycle << " " << setw(3) << r.beamY << " "
+       << setw(3) << (int)r.beamX << " " << (r.getRW() ? "R" : "W")
+       << (r.getRDY() ? " " : "*") << hex << setfill('0') << nouppercase << setw(4)
+       << r.address << " " << setw(2) << (int)r.data << " T" << r.getT() << " ";
+
+    // Disassemble the instruction at the opcode fetch, which is the read
+    // followed by the first cycle of an instruction (T1). This is usually
+    // at T0, but not always (for example for taken branches).
+    bool fetch = (k + 1 < numRecords) ? records[k + 1].getT() == 1 : r.getT() == 0;
+    fetch = fetch && r.getRW() && r.getRDY();
+    if (!fetch) {
+      os << da;
+    } else {
+      ostringstream ds;
+      ds << da;
+      os << left << setfill(' ') << setw(10) << ds.str() << right;
+      array<uint8_t, 3> bytes{{r.data, 0, 0}};
+      int length = M6502::decode(r.data).length;
+      bool complete = true;
+      size_t j = k + 1;
+      for (int i = 1; i < length && complete; ++i) {
+        // Skip the stalled reads, which repeat the same access.
+        while (j < numRecords && !records[j].getRDY()) ++j;
+        complete = (j < numRecords && records[j].address == ((r.address + i) & 0xffff));
+        if (complete) bytes[i] = records[j++].data;
+      }
+      os << " ";
+      if (complete) {
+        Atari2600::printInstruction(os, M6502::decode(bytes));
+      } else {
+        os << M6502::decode(r.data).mnemonic << " ?";
+      }
+    }
+    os << dec << "\n";
+  }
+}
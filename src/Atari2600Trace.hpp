@@ -0,0 +1,132 @@
+// Atari2600Trace.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600Trace_hpp
+#define Atari2600Trace_hpp
+
+#include "M6502.hpp"
+#include "TIA.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Trace record
+// -----------------------------------------------------------------
+
+/// A bus cycle, packed in 16 bytes. Trace files are arrays of records in
+/// the byte order of the host (little endian on all supported platforms).
+struct Atari2600TraceRecord {
+  std::uint64_t cycle;   /// CPU cycle number.
+  std::uint16_t address; /// Address bus.
+  std::uint8_t data;     /// Data bus at the end of the cycle.
+  std::uint8_t IR;       /// CPU instruction register.
+  std::uint8_t beamX;    /// TIA beam position at the end of the cycle.
+  std::uint8_t flags;    /// RW (bit 0), RDY (bit 1), and T (bits 4-7).
+  std::uint16_t beamY;
+
+  enum : std::uint8_t { RW = 0x01, RDY = 0x02 };
+  bool getRW() const { return flags & RW; }
+  bool getRDY() const { return flags & RDY; }
+  int getT() const { return flags >> 4; }
+};
+
+static_assert(sizeof(Atari2600TraceRecord) == 16, "Trace records must be 16 bytes");
+
+void printTrace(std::ostream& os, Atari2600TraceRecord const* records, size_t numRecords,
+                size_t numPrinted);
+
+// -----------------------------------------------------------------
+// MARK: - Trace recorder
+// -----------------------------------------------------------------
+
+/// Record the bus cycles of a machine (see `Atari2600::setTraceRecorder()`)
+/// into a lock-free ring buffer with a single producer, the emulation
+/// thread, and a single consumer. The consumer is either a thread writing
+/// the records to a file, started by `open()`, or the caller of `drain()`.
+///
+/// When writing to a file, the producer waits for room in the buffer, so
+/// that no record is lost. Otherwise, the records that do not fit are
+/// dropped and counted.
+class Atari2600TraceRecorder {
+public:
+  // Lifecycle.
+  explicit Atari2600TraceRecorder(size_t capacity = (1 << 16));
+  ~Atari2600TraceRecorder();
+  Atari2600TraceRecorder(Atari2600TraceRecorder const&) = delete;
+  Atari2600TraceRecorder& operator=(Atari2600TraceRecorder const&) = delete;
+
+  // Produce.
+  void record(M6502State const& cpu, TIAState const& tia);
+
+  // Consume.
+  void open(std::string const& path);
+  void close();
+  bool isOpen() const { return flusher.joinable(); }
+  size_t drain(Atari2600TraceRecord* records, size_t maxNumRecords);
+
+  // Inspect.
+  size_t getCapacity() const { return ring.size(); }
+  size_t size() const;
+  std::uint64_t getNumRecords() const { return numRecords; }
+  std::uint64_t getNumDropped() const { return numDropped; }
+
+protected:
+  void push(Atari2600TraceRecord const& record);
+  void flush();
+
+  std::vector<Atari2600TraceRecord> ring;
+  size_t mask;
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+  std::uint64_t numRecords{0};
+  std::uint64_t numDropped{0};
+
+  // Flusher.
+  std::ofstream file;
+  std::thread flusher;
+  std::atomic<bool> flushing{false};
+};
+
+// -----------------------------------------------------------------
+// MARK: - Inline members
+// -----------------------------------------------------------------
+
+/// Record the current bus cycle. The TIA must be up to date. Called by the
+/// producer only.
+inline void Atari2600TraceRecorder::record(M6502State const& cpu, TIAState const& tia) {
+  Atari2600TraceRecord r;
+  r.cycle = cpu.getNumCycles();
+  r.address = cpu.getAddressBus();
+  r.data = cpu.getDataBus();
+  r.IR = cpu.getIR();
+  r.beamX = static_cast<std::uint8_t>(tia.beamX);
+  r.flags = static_cast<std::uint8_t>((cpu.getRW() ? Atari2600TraceRecord::RW : 0) |
+                                      (tia.RDY ? Atari2600TraceRecord::RDY : 0) |
+                                      ((cpu.getT() & 0xf) << 4));
+  r.beamY = static_cast<std::uint16_t>(tia.beamY);
+  auto h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) <= mask) {
+    ring[h & mask] = r;
+    head.store(h + 1, std::memory_order_release);
+    ++numRecords;
+  } else {
+    push(r);
+  }
+}
+
+} // namespace jigo
+
+#endif /* Atari2600Trace_hpp */
@@ -0,0 +1,171 @@
+// Atari2600Vector.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "Atari2600Vector.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+using namespace std;
+using namespace jigo;
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+/// Create an empty vector of machines. The machines are stepped by
+/// `numThreads` threads, including the calling one. If `numThreads` is zero,
+/// the number of hardware threads is used instead.
+Atari2600Vector::Atari2600Vector(size_t numThreads)
+ : generation(0), numBusyWorkers(0), stepping(false), quit(false), nextJob(0),
+   inputs(nullptr) {
+  if (numThreads == 0) {
+    numThreads = max(1u, thread::hardware_concurrency());
+  }
+  for (size_t k = 1; k < numThreads; ++k) {
+    workers.emplace_back(&Atari2600Vector::work, this);
+  }
+}
+
+Atari2600Vector::~Atari2600Vector() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  wakeUp.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+// -------------------------------------------------------------------
+// MARK: - Manipulate the machines
+// -------------------------------------------------------------------
+
+/// Add a machine to the vector and return its index. Machines may use
+/// different cartridges. The result arrays are reallocated, so that the
+/// pointers previously obtained from `getObservations()` and the like are
+/// invalidated. Throws `std::logic_error` if a step is running.
+size_t Atari2600Vector::addMachine(shared_ptr<Atari2600> machine) {
+  assert(machine);
+  lock_guard<std::mutex> lock(mutex);
+  if (stepping) {
+    throw logic_error("Cannot add a machine while stepping");
+  }
+  machines.push_back(machine);
+  observations.resize(machines.size() * TIA::screenWidth * TIA::screenHeight);
+  rewards.resize(machines.size());
+  dones.resize(machines.size());
+  stoppingReasons.resize(machines.size());
+  return machines.size() - 1;
+}
+
+/// Get the machine at `index`. Throws `std::out_of_range` if there is none.
+shared_ptr<Atari2600> Atari2600Vector::getMachine(size_t index) const {
+  if (index >= machines.size()) {
+    throw out_of_range("Machine index out of range");
+  }
+  return machines[index];
+}
+
+/// Set the function computing the reward of a machine after each step. The
+/// function is called from the worker threads, concurrently for different
+/// machines.
+void Atari2600Vector::setRewardFunction(RewardFunction function) {
+  rewardFunction = function;
+}
+
+/// Set the function deciding if a machine is done after each step. The
+/// function is called from the worker threads, concurrently for different
+/// machines.
+void Atari2600Vector::setDoneFunction(DoneFunction function) {
+  doneFunction = function;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Simulation
+// -------------------------------------------------------------------
+
+/// Advance all machines by one frame. If `inputs` is not null, machine k
+/// first receives the inputs `inputs[k]`. On return, the observations,
+/// rewards, done flags, and stopping reasons contain the outcome of the
+/// step. A machine that stops before the end of the frame, because of a
+/// breakpoint, a watchpoint, or the CPU cycle limit, is done and keeps its
+/// previous observation if the frame did not end.
+///
+/// Machines are handed out dynamically to idle threads one at a time, so
+/// that slow machines do not hold back the others. Exceptions thrown by
+/// the hooks are rethrown here. Throws `std::logic_error` if another step
+/// is running.
+void Atari2600Vector::step(Atari2600::FrameInput const* inputs) {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    if (stepping) {
+      throw logic_error("A step is already running");
+    }
+    stepping = true;
+    this->inputs = inputs;
+    nextJob = 0;
+    error = nullptr;
+    numBusyWorkers = workers.size();
+    generation++;
+  }
+  wakeUp.notify_all();
+  runJobs();
+  {
+    unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return numBusyWorkers == 0; });
+    this->inputs = nullptr;
+    stepping = false;
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
+}
+
+void Atari2600Vector::work() {
+  size_t lastGeneration = 0;
+  for (;;) {
+    {
+      unique_lock<std::mutex> lock(mutex);
+      wakeUp.wait(lock, [&] { return quit || generation != lastGeneration; });
+      if (quit) return;
+      lastGeneration = generation;
+    }
+    runJobs();
+    {
+      lock_guard<std::mutex> lock(mutex);
+      if (--numBusyWorkers == 0) finished.notify_one();
+    }
+  }
+}
+
+void Atari2600Vector::runJobs() {
+  for (;;) {
+    size_t index = nextJob++;
+    if (index >= machines.size()) break;
+    try {
+      stepMachine(index);
+    } catch (...) {
+      lock_guard<std::mutex> lock(mutex);
+      if (!error) error = current_exception();
+    }
+  }
+}
+
+void Atari2600Vector::stepMachine(size_t index) {
+  auto& machine = *machines[index];
+  auto screen = observations.data() + index * TIA::screenWidth * TIA::screenHeight;
+  size_t numFrames = 1;
+  auto reason = machine.runFrames(numFrames, inputs ? inputs + index : nullptr, screen);
+  bool stopped = numFrames > 0 || reason[Atari2600::StoppingReason::breakpoint] ||
+                 reason[Atari2600::StoppingReason::watchpoint];
+  stoppingReasons[index] = reason;
+  rewards[index] = rewardFunction ? rewardFunction(index, machine) : 0.0f;
+  dones[index] = stopped || (doneFunction && doneFunction(index, machine));
+}
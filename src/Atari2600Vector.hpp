@@ -0,0 +1,95 @@
+// Atari2600Vector.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef Atari2600Vector_hpp
+#define Atari2600Vector_hpp
+
+#include "Atari2600.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Atari2600Vector
+// -----------------------------------------------------------------
+
+/// A collection of machines stepped one frame at a time in lock-step by a
+/// pool of worker threads. The frames produced by the machines are collected
+/// in a single contiguous `[N, H, W]` array of ARGB pixels. Adding a machine
+/// reallocates the array, invalidating the pointers to it, and is not
+/// allowed during a step.
+class Atari2600Vector {
+public:
+  using RewardFunction = std::function<float(size_t index, Atari2600 const& machine)>;
+  using DoneFunction = std::function<bool(size_t index, Atari2600 const& machine)>;
+
+  // Lifecycle.
+  explicit Atari2600Vector(size_t numThreads = 0);
+  ~Atari2600Vector();
+  Atari2600Vector(Atari2600Vector const&) = delete;
+  Atari2600Vector& operator=(Atari2600Vector const&) = delete;
+
+  // Manipulate the machines.
+  size_t addMachine(std::shared_ptr<Atari2600> machine);
+  std::shared_ptr<Atari2600> getMachine(size_t index) const;
+  size_t size() const { return machines.size(); }
+  size_t getNumThreads() const { return workers.size() + 1; }
+
+  // Hooks.
+  void setRewardFunction(RewardFunction function);
+  void setDoneFunction(DoneFunction function);
+
+  // Run the simulation.
+  void step(Atari2600::FrameInput const* inputs = nullptr);
+
+  // Access the results of the last step.
+  std::uint32_t const* getObservations() const { return observations.data(); }
+  float const* getRewards() const { return rewards.data(); }
+  std::uint8_t const* getDones() const { return dones.data(); }
+  Atari2600::StoppingReason const* getStoppingReasons() const {
+    return stoppingReasons.data();
+  }
+
+protected:
+  void work();
+  void runJobs();
+  void stepMachine(size_t index);
+
+  std::vector<std::shared_ptr<Atari2600>> machines;
+  std::vector<std::uint32_t> observations;
+  std::vector<float> rewards;
+  std::vector<std::uint8_t> dones;
+  std::vector<Atari2600::StoppingReason> stoppingReasons;
+  RewardFunction rewardFunction;
+  DoneFunction doneFunction;
+
+  // Thread pool.
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  std::condition_variable finished;
+  size_t generation;
+  size_t numBusyWorkers;
+  bool stepping;
+  bool quit;
+  std::atomic<size_t> nextJob;
+  std::exception_ptr error;
+  Atari2600::FrameInput const* inputs;
+};
+
+} // namespace jigo
+
+#endif /* Atari2600Vector_hpp */
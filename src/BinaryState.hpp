@@ -0,0 +1,147 @@
+// BinaryState.hpp
+// Binary state serialization
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef BinaryState_hpp
+#define BinaryState_hpp
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - Writer and reader
+// -----------------------------------------------------------------
+
+/// Append values to a byte vector using a fixed little-endian layout.
+class BinaryWriter {
+public:
+  explicit BinaryWriter(std::vector<std::uint8_t>& bytes) : bytes(bytes) {}
+
+  void putUnsigned(std::uint64_t value, int numBytes) {
+    for (int k = 0; k < numBytes; ++k) {
+      bytes.push_back(static_cast<std::uint8_t>(value >> (8 * k)));
+    }
+  }
+
+  void putBytes(void const* data, size_t size) {
+    auto begin = static_cast<std::uint8_t const*>(data);
+    bytes.insert(bytes.end(), begin, begin + size);
+  }
+
+protected:
+  std::vector<std::uint8_t>& bytes;
+};
+
+/// Read values written by `BinaryWriter`. Throws `std::invalid_argument` if
+/// the data is truncated.
+class BinaryReader {
+public:
+  BinaryReader(std::uint8_t const* begin, std::uint8_t const* end)
+   : current(begin), end(end) {}
+
+  std::uint64_t getUnsigned(int numBytes) {
+    require(numBytes);
+    std::uint64_t value = 0;
+    for (int k = 0; k < numBytes; ++k) {
+      value |= static_cast<std::uint64_t>(*current++) << (8 * k);
+    }
+    return value;
+  }
+
+  void getBytes(void* data, size_t size) {
+    require(size);
+    memcpy(data, current, size);
+    current += size;
+  }
+
+  size_t getNumRemainingBytes() const { return end - current; }
+
+protected:
+  void require(size_t size) const {
+    if ((size_t)(end - current) < size) {
+      throw std::invalid_argument("Binary state is truncated");
+    }
+  }
+
+  std::uint8_t const* current;
+  std::uint8_t const* end;
+};
+
+// -----------------------------------------------------------------
+// MARK: - Basic types
+// -----------------------------------------------------------------
+
+// Integers are stored with their own size; enumerations as 32-bit integers;
+// floats by their IEEE 754 representation; booleans as one byte.
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+void to_binary(BinaryWriter& w, T x) {
+  static_assert(sizeof(T) <= 8, "Unsupported integer size");
+  w.putUnsigned(static_cast<std::uint64_t>(x), sizeof(T));
+}
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+void from_binary(BinaryReader& r, T& x) {
+  x = static_cast<T>(r.getUnsigned(sizeof(T)));
+}
+
+inline void to_binary(BinaryWriter& w, bool x) { w.putUnsigned(x, 1); }
+
+inline void from_binary(BinaryReader& r, bool& x) { x = r.getUnsigned(1) != 0; }
+
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+void to_binary(BinaryWriter& w, T x) {
+  w.putUnsigned(static_cast<std::uint32_t>(x), 4);
+}
+
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+void from_binary(BinaryReader& r, T& x) {
+  x = static_cast<T>(static_cast<std::int32_t>(r.getUnsigned(4)));
+}
+
+inline void to_binary(BinaryWriter& w, float x) {
+  std::uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  w.putUnsigned(bits, 4);
+}
+
+inline void from_binary(BinaryReader& r, float& x) {
+  auto bits = static_cast<std::uint32_t>(r.getUnsigned(4));
+  memcpy(&x, &bits, sizeof(bits));
+}
+
+template <size_t n> void to_binary(BinaryWriter& w, std::bitset<n> const& x) {
+  static_assert(n <= 64, "Unsupported bitset size");
+  w.putUnsigned(x.to_ullong(), (n + 7) / 8);
+}
+
+template <size_t n> void from_binary(BinaryReader& r, std::bitset<n>& x) {
+  x = std::bitset<n>(r.getUnsigned((n + 7) / 8));
+}
+
+template <typename T, size_t n>
+void to_binary(BinaryWriter& w, std::array<T, n> const& x) {
+  for (auto const& y : x) {
+    to_binary(w, y);
+  }
+}
+
+template <typename T, size_t n> void from_binary(BinaryReader& r, std::array<T, n>& x) {
+  for (auto& y : x) {
+    from_binary(r, y);
+  }
+}
+
+} // namespace jigo
+
+#endif /* BinaryState_hpp */
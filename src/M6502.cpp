@@ -140,6 +140,61 @@ void jigo::from_json(const json& j, M6502State& state) {
   jget(resetLine);
 }
 
+void jigo::to_binary(BinaryWriter& w, const M6502State& s) {
+#define bput(x) to_binary(w, s.x)
+  bput(RW);
+  bput(addressBus);
+  bput(dataBus);
+  bput(A);
+  bput(X);
+  bput(Y);
+  bput(S);
+  bput(PC);
+  bput(IR);
+  to_binary(w, static_cast<uint8_t>(s.P));
+  bput(PCIR);
+  bput(PCP);
+  bput(AD);
+  bput(ADD);
+  bput(T);
+  bput(TP);
+  to_binary(w, static_cast<uint64_t>(s.numCycles));
+  bput(nmiLine);
+  bput(irqLine);
+  bput(resetLine);
+#undef bput
+}
+
+/// Throws `std::invalid_argument` if the data is truncated.
+void jigo::from_binary(BinaryReader& r, M6502State& state) {
+#define bget(x) from_binary(r, state.x)
+  bget(RW);
+  bget(addressBus);
+  bget(dataBus);
+  bget(A);
+  bget(X);
+  bget(Y);
+  bget(S);
+  bget(PC);
+  bget(IR);
+  uint8_t P;
+  from_binary(r, P);
+  state.P = P;
+  bget(PCIR);
+  bget(PCP);
+  bget(AD);
+  bget(ADD);
+  bget(T);
+  bget(TP);
+  uint64_t numCycles;
+  from_binary(r, numCycles);
+  state.numCycles = numCycles;
+  bget(nmiLine);
+  bget(irqLine);
+  bget(resetLine);
+#undef bget
+}
+
 // -------------------------------------------------------------------
 // MARK: - Helpers
 // -------------------------------------------------------------------
@@ -672,6 +727,139 @@ inline uint8_t M6502::xROR(uint8_t value) {
   return setNZ(value = (value >> 1) | (bit << 7));
 }
 
+// MARK: Instruction execution
+
+// These complete the execution of an instruction once its operand is
+// available. They are shared by `cycle()` and `step()`.
+
+void M6502::executeImplied() {
+  switch (dc.instructionType) {
+  case ASL: ADD = xASL(A); break;
+  case DEX: ADD = setNZ(X - 1); break;
+  case DEY: ADD = setNZ(Y - 1); break;
+  case INX: ADD = setNZ(X + 1); break;
+  case INY: ADD = setNZ(Y + 1); break;
+  case LSR: ADD = xLSR(A); break;
+  case ROL: ADD = xROL(A); break;
+  case ROR: ADD = xROR(A); break;
+  case CLC: P[P.c] = 0; break;
+  case CLD: P[P.d] = 0; break;
+  case CLI: P[P.i] = 0; break;
+  case CLV: P[P.v] = 0; break;
+  case NOP:; break;
+  case SEC: P[P.c] = 1; break;
+  case SED: P[P.d] = 1; break;
+  case SEI: P[P.i] = 1; break;
+  case TAX: setNZ(X = A); break;
+  case TAY: setNZ(Y = A); break;
+  case TSX: setNZ(X = S); break;
+  case TXA: setNZ(A = X); break;
+  case TXS: S = X; break; // Does not affect flags.
+  case TYA: setNZ(A = Y); break;
+  case KIL: break;
+  default: break;
+  }
+}
+
+void M6502::executeRead(uint8_t value) {
+  switch (dc.instructionType) {
+  case ADC: ADD = xADC(value); break;
+  case ALR: ADD = xALR(value); break;
+  case ANC: ADD = xANC(value); break;
+  case AND: ADD = xAND(value); break;
+  case ARR: ADD = xARR(value); break;
+  case AXS: ADD = xAXS(value); break;
+  case BIT: xBIT(value); break;
+  case CMP: xCMP(value); break;
+  case CPX: xCPX(value); break;
+  case CPY: xCPY(value); break;
+  case EOR: ADD = xEOR(value); break;
+  case LAS:
+#ifdef LAS_LIKE_VISUAL6502
+    X = S;
+    setNZ(S & value);
+    A = (S & (value | 0x11));
+#else
+    setNZ(X = (A = (SP &= value)));
+#endif
+    break;
+  case LAX: setNZ(X = (A = value)); break;
+  case LDA: setNZ(A = value); break;
+  case LDX: setNZ(X = value); break;
+  case LDY: setNZ(Y = value); break;
+  case NOP: break;
+  case ORA: ADD = xORA(value); break;
+  case SBC: ADD = xSBC(value); break;
+  case XAA:
+#ifdef XAA_LIKE_VISUAL6502
+    setNZ(A = A & X & value);
+#else
+    setNZ(A = (A | 0xee) & X & value);
+#endif
+    break;
+  default: assert(false);
+  }
+}
+
+void M6502::executeWrite() {
+  switch (dc.instructionType) {
+  case STA: writeTo(AD, A); break;
+  case STX: writeTo(AD, X); break;
+  case STY: writeTo(AD, Y); break;
+  case SAX: writeTo(AD, A & X); break;
+  case TAS:
+  case SHX:
+  case SHY:
+  case AHX: writeTo(AD, ADD); break;
+  default: assert(false);
+  }
+}
+
+uint8_t M6502::executeModify(uint8_t value) {
+  switch (dc.instructionType) {
+  case ASL:
+  case SLO: return xASL(value);
+  case DEC:
+  case DCP: return setNZ(value - 1);
+  case INC:
+  case ISC: return setNZ(value + 1);
+  case LSR:
+  case SRE: return xLSR(value);
+  case ROL:
+  case RLA: return xROL(value);
+  case ROR:
+  case RRA: return xROR(value);
+  default: assert(false); return ADD;
+  }
+}
+
+/// Complete the illegal read-modify-write instructions.
+void M6502::executeModifyCompletion() {
+  switch (dc.instructionType) {
+  case DCP: xCMP(ADD); break;
+  case ISC: ADD = xSBC(ADD); break;
+  case RLA: ADD = xAND(ADD); break;
+  case RRA: ADD = xADC(ADD); break;
+  case SLO: ADD = xORA(ADD); break;
+  case SRE: ADD = xEOR(ADD); break;
+  default: break;
+  }
+}
+
+bool M6502::isBranchTaken() const {
+  switch (dc.instructionType) {
+  case BCC: return (P[P.c] == 0);
+  case BCS: return (P[P.c] == 1);
+  case BNE: return (P[P.z] == 0);
+  case BEQ: return (P[P.z] == 1);
+  case BPL: return (P[P.n] == 0);
+  case BMI: return (P[P.n] == 1);
+  case BVC: return (P[P.v] == 0);
+  case BVS: return (P[P.v] == 1);
+  default: assert(false); return false;
+  }
+}
+
 // -------------------------------------------------------------------
 // MARK: - Simulation core
 // -------------------------------------------------------------------
@@ -754,39 +942,15 @@ void M6502::cycle(bool busWasReady) {
       TP = 1;
     } // KIL.
     else if (T == 0) {
-      switch (dc.instructionType) {
-      case ASL: ADD = xASL(A); break;
-      case DEX: ADD = setNZ(X - 1); break;
-      case DEY: ADD = setNZ(Y - 1); break;
-      case INX: ADD = setNZ(X + 1); break;
-      case INY: ADD = setNZ(Y + 1); break;
-      case LSR: ADD = xLSR(A); break;
-      case ROL: ADD = xROL(A); break;
-      case ROR: ADD = xROR(A); break;
-      case CLC: P[P.c] = 0; break;
-      case CLD: P[P.d] = 0; break;
-      case CLI: P[P.i] = 0; break;
-      case CLV: P[P.v] = 0; break;
-      case NOP:; break;
-      case SEC: P[P.c] = 1; break;
-      case SED: P[P.d] = 1; break;
-      case SEI: P[P.i] = 1; break;
-      case TAX: setNZ(X = A); break;
-      case TAY: setNZ(Y = A); break;
-      case TSX: setNZ(X = S); break;
-      case TXA: setNZ(A = X); break;
-      case TXS: S = X; break; // Does not affect flags.
-      case TYA: setNZ(A = Y); break;
-      case KIL: break;
-      default: break;
-      }
+      executeImplied();
       fetch();
     } else {
       assert(false);
     }
   }
 
-  else if (dc.accessType == read || dc.accessType == write || dc.accessType == readWrite) {
+  else if (dc.accessType == read || dc.accessType == write ||
+           dc.accessType == readWrite) {
     int Tx;
     switch (dc.addressingMode) {
       // On T==Tx this code is completed below using AD.
@@ -925,57 +1089,11 @@ void M6502::cycle(bool busWasReady) {
         TP = -1;
       } else if (T == 0) {
         fetch();
-        switch (dc.instructionType) {
-        case ADC: ADD = xADC(dataBus); break;
-        case ALR: ADD = xALR(dataBus); break;
-        case ANC: ADD = xANC(dataBus); break;
-        case AND: ADD = xAND(dataBus); break;
-        case ARR: ADD = xARR(dataBus); break;
-        case AXS: ADD = xAXS(dataBus); break;
-        case BIT: xBIT(dataBus); break;
-        case CMP: xCMP(dataBus); break;
-        case CPX: xCPX(dataBus); break;
-        case CPY: xCPY(dataBus); break;
-        case EOR: ADD = xEOR(dataBus); break;
-        case LAS:
-#ifdef LAS_LIKE_VISUAL6502
-          X = S;
-          setNZ(S & dataBus);
-          A = (S & (dataBus | 0x11));
-#else
-          setNZ(X = (A = (SP &= dataBus)));
-#endif
-          break;
-        case LAX: setNZ(X = (A = dataBus)); break;
-        case LDA: setNZ(A = dataBus); break;
-        case LDX: setNZ(X = dataBus); break;
-        case LDY: setNZ(Y = dataBus); break;
-        case NOP: break;
-        case ORA: ADD = xORA(dataBus); break;
-        case SBC: ADD = xSBC(dataBus); break;
-        case XAA:
-#ifdef XAA_LIKE_VISUAL6502
-          setNZ(A = A & X & dataBus);
-#else
-          setNZ(A = (A | 0xee) & X & dataBus);
-#endif
-          break;
-        default: assert(false);
-        }
+        executeRead(dataBus);
       }
     } else if (dc.accessType == write) {
       if (T == Tx) {
-        switch (dc.instructionType) {
-        case STA: writeTo(AD, A); break;
-        case STX: writeTo(AD, X); break;
-        case STY: writeTo(AD, Y); break;
-        case SAX: writeTo(AD, A & X); break;
-        case TAS:
-        case SHX:
-        case SHY:
-        case AHX: writeTo(AD, ADD); break;
-        default: assert(false);
-        }
+        executeWrite();
         TP = -1;
       } else if (T == 0) {
         fetch();
@@ -988,37 +1106,14 @@ void M6502::cycle(bool busWasReady) {
       if (T == Tx) {
         readFrom(AD);
       } else if (T == Tx + 1) {
-        switch (dc.instructionType) {
-        case ASL:
-        case SLO: ADD = xASL(dataBus); break;
-        case DEC:
-        case DCP: ADD = setNZ(dataBus - 1); break;
-        case INC:
-        case ISC: ADD = setNZ(dataBus + 1); break;
-        case LSR:
-        case SRE: ADD = xLSR(dataBus); break;
-        case ROL:
-        case RLA: ADD = xROL(dataBus); break;
-        case ROR:
-        case RRA: ADD = xROR(dataBus); break;
-        default: assert(false);
-        }
+        ADD = executeModify(dataBus);
         writeTo(AD, dataBus); // Discarded.
       } else if (T == Tx + 2) {
         writeTo(AD, ADD);
         TP = -1;
       } else if (T == 0) {
         fetch();
-        // Illegal opcodes.
-        switch (dc.instructionType) {
-        case DCP: xCMP(ADD); break;
-        case ISC: ADD = xSBC(ADD); break;
-        case RLA: ADD = xAND(ADD); break;
-        case RRA: ADD = xADC(ADD); break;
-        case SLO: ADD = xORA(ADD); break;
-        case SRE: ADD = xEOR(ADD); break;
-        default: break;
-        }
+        executeModifyCompletion();
       }
     }
   }
@@ -1027,19 +1122,7 @@ void M6502::cycle(bool busWasReady) {
     if (T == 1) {
       fetch();
     } else if (T == 2) {
-      bool takeBranch;
-      switch (dc.instructionType) {
-      case BCC: takeBranch = (P[P.c] == 0); break;
-      case BCS: takeBranch = (P[P.c] == 1); break;
-      case BNE: takeBranch = (P[P.z] == 0); break;
-      case BEQ: takeBranch = (P[P.z] == 1); break;
-      case BPL: takeBranch = (P[P.n] == 0); break;
-      case BMI: takeBranch = (P[P.n] == 1); break;
-      case BVC: takeBranch = (P[P.v] == 0); break;
-      case BVS: takeBranch = (P[P.v] == 1); break;
-      default: assert(false);
-      }
-      if (takeBranch) {
+      if (isBranchTaken()) {
         readFrom(PC); // Discarded.
         uint16_t rel = (unsigned)static_cast<int8_t>(dataBus);
         AD = PC + rel;
@@ -1258,3 +1341,425 @@ void M6502::cycle(bool busWasReady) {
   // One more cycle completed.
   numCycles++;
 }
+
+/// Simulate a complete instruction at once, from the fetch of its opcode
+/// (T=1) to the fetch of the next opcode, and return the number of cycles
+/// used. Each bus access is passed to `bus` in order, one per cycle, with
+/// the same addresses, data and timing as the equivalent sequence of calls
+/// to `cycle()`, including the discarded reads and writes and the read
+/// cycles repeated while RDY is low. Hence the resulting bus trace and
+/// state are identical.
+///
+/// The decoding and dispatch is done once per instruction rather than once
+/// per cycle. If the CPU is not at an instruction boundary (for instance,
+/// after loading a state saved in the middle of an instruction, or after a
+/// KIL), a single cycle is simulated with `cycle()`.
+
+size_t M6502::step(M6502Bus& bus) {
+  size_t const firstCycle = numCycles;
+
+  if (!isAtInstructionBoundary() || verbose) {
+    cycle(bus.isReady());
+    bus.cycle(*this);
+    return numCycles - firstCycle;
+  }
+
+  // A cycle begins by repeating a read while RDY is low and loading PC from
+  // PCP, and ends with the bus access set up by readFrom() or writeTo().
+  auto begin = [&](int t) {
+    while (!bus.isReady() && RW) {
+      ++numCycles;
+      bus.cycle(*this);
+    }
+    PC = PCP;
+    T = t;
+  };
+  auto end = [&]() {
+    ++numCycles;
+    bus.cycle(*this);
+  };
+
+  // T=1: complete the previous instruction and load the new one.
+  begin(1);
+  if (dc.addToA) {
+    A = ADD;
+  } else if (dc.instructionType == DEX || dc.instructionType == INX ||
+             dc.instructionType == AXS) {
+    X = ADD;
+  } else if (dc.instructionType == DEY || dc.instructionType == INY) {
+    Y = ADD;
+  }
+  if (resetLine || nmiLine || (irqLine & !P[P.i])) {
+    IR = 0x00; // BRK
+  } else {
+    IR = dataBus;
+    PCIR = addressBus;
+  }
+  dc = decode(IR);
+
+  if (dc.accessType == noAccess) {
+    readFrom(PC); // Discarded.
+    if (dc.instructionType == KIL) {
+      PCP = PC + 1;
+      TP = 2;
+      end();
+      return numCycles - firstCycle;
+    }
+    end();
+    begin(0);
+    executeImplied();
+    fetch();
+    end();
+  }
+
+  else if (dc.accessType == read || dc.accessType == write ||
+           dc.accessType == readWrite) {
+    // Compute the effective address in AD. The last cycle of the addressing
+    // mode (Tx) is left open for the access itself.
+    int Tx;
+    bool const skippable = (dc.accessType == read);
+    switch (dc.addressingMode) {
+    case immediate:
+      Tx = 1;
+      AD = PC;
+      PCP = PC + 1;
+      break;
+
+    case zeroPage:
+      Tx = 2;
+      fetch();
+      end();
+      begin(2);
+      AD = dataBus;
+      break;
+
+    case zeroPageIndexed:
+      Tx = 3;
+      fetch();
+      end();
+      begin(2);
+      AD = dataBus;
+      readFrom(AD); // Discarded.
+      AD = (AD + ((dc.indexingType == XIndexing) ? X : Y)) & 0x00ff;
+      end();
+      begin(3);
+      break;
+
+    case zeroPageIndexedIndirect:
+      Tx = 5;
+      fetch();
+      end();
+      begin(2);
+      readFrom(ADD = dataBus); // Discarded.
+      ADD += X;
+      end();
+      begin(3);
+      readFrom(ADD);
+      end();
+      begin(4);
+      readFrom(uint8_t(ADD + 1));
+      AD = dataBus;
+      end();
+      begin(5);
+      AD |= uint16_t(dataBus) << 8;
+      break;
+
+    case zeroPageIndirectIndexed: {
+      Tx = 5;
+      fetch();
+      end();
+      begin(2);
+      readFrom(AD = dataBus);
+      end();
+      begin(3);
+      readFrom((AD + 1) & 0xff);
+      AD = uint16_t(dataBus) + Y;
+      end();
+      begin(4);
+      bool carry = (AD >= 0x100);
+      AD = (AD & 0xff) | uint16_t(dataBus) << 8;
+      if (skippable && !carry) {
+        T = 5; // Skip step.
+      } else {
+        readFrom(AD); // Discarded.
+        if (dc.instructionType == AHX) {
+          ADD = A & X & ((AD >> 8) + 1);
+        }
+        if (carry) {
+          AD += 0x100;
+          if (dc.instructionType == AHX) {
+            AD = (AD & 0xff) | (uint16_t(ADD) << 8);
+          }
+        }
+        end();
+        begin(5);
+      }
+      break;
+    }
+
+    case absolute:
+      Tx = 3;
+      fetch();
+      end();
+      begin(2);
+      AD = dataBus;
+      fetch();
+      end();
+      begin(3);
+      AD |= uint16_t(dataBus) << 8;
+      break;
+
+    case absoluteIndexed: {
+      Tx = 4;
+      fetch();
+      end();
+      begin(2);
+      fetch();
+      AD = uint16_t(dataBus) + ((dc.indexingType == XIndexing) ? X : Y);
+      end();
+      begin(3);
+      bool carry = (AD >= 0x100);
+      AD = (AD & 0xff) | (uint16_t(dataBus) << 8);
+      if (skippable && !carry) {
+        T = 4; // Skip step.
+      } else {
+        readFrom(AD); // Discarded.
+        if (dc.instructionType == AHX || dc.instructionType == TAS) {
+          ADD = A & X & ((AD >> 8) + 1);
+        } else if (dc.instructionType == SHX) {
+          ADD = X & ((AD >> 8) + 1);
+        } else if (dc.instructionType == SHY) {
+          ADD = Y & ((AD >> 8) + 1);
+        }
+        if (carry) {
+          AD += 0x100;
+          if (dc.instructionType == AHX || dc.instructionType == SHX ||
+              dc.instructionType == SHY || dc.instructionType == TAS) {
+            AD = (AD & 0xff) | (uint16_t(ADD) << 8);
+          }
+        }
+        end();
+        begin(4);
+      }
+      break;
+    }
+
+    default: assert(false); Tx = T;
+    }
+
+    if (dc.accessType == read) {
+      readFrom(AD);
+      end();
+      begin(0);
+      fetch();
+      executeRead(dataBus);
+      end();
+    } else if (dc.accessType == write) {
+      executeWrite();
+      end();
+      begin(0);
+      fetch();
+      // Illegal opcode.
+      if (dc.instructionType == TAS) {
+        S = A & X;
+      }
+      end();
+    } else {
+      readFrom(AD);
+      end();
+      begin(Tx + 1);
+      ADD = executeModify(dataBus);
+      writeTo(AD, dataBus); // Discarded.
+      end();
+      begin(Tx + 2);
+      writeTo(AD, ADD);
+      end();
+      begin(0);
+      fetch();
+      executeModifyCompletion();
+      end();
+    }
+  }
+
+  else if (dc.accessType == branch) {
+    fetch();
+    end();
+    begin(2);
+    if (isBranchTaken()) {
+      readFrom(PC); // Discarded.
+      uint16_t rel = (unsigned)static_cast<int8_t>(dataBus);
+      AD = PC + rel;
+      PCP = (PC & 0xff00) | (AD & 0x00ff);
+      end();
+      begin(3);
+      if (PC != AD) {
+        readFrom(PC); // Discarded.
+        PCP = AD;
+        end();
+        begin(4);
+      }
+    }
+    fetch();
+    end();
+  }
+
+  else if (dc.instructionType == JMP) {
+    fetch();
+    end();
+    begin(2);
+    AD = dataBus;
+    fetch();
+    if (dc.addressingMode == absoluteIndirect) {
+      end();
+      begin(3);
+      AD |= uint16_t(dataBus) << 8;
+      readFrom(AD);
+      end();
+      begin(4);
+      // Bug in most 6502: carry not propagated in summation.
+      readFrom((AD & 0xff00) | ((AD + 1) & 0x00ff));
+      AD = dataBus;
+    }
+    end();
+    begin(0);
+    PC = (AD |= uint16_t(dataBus) << 8);
+    fetch();
+    end();
+  }
+
+  else if (dc.instructionType == JSR) {
+    fetch();
+    end();
+    begin(2);
+    AD = dataBus;
+    readFrom(0x100 + S);
+    end();
+    begin(3);
+    writeTo(0x100 + S--, (PC >> 8) & 0xff);
+    end();
+    begin(4);
+    writeTo(0x100 + S--, PC & 0xff);
+    end();
+    begin(5);
+    fetch();
+    end();
+    begin(0);
+    PC = (AD |= uint16_t(dataBus) << 8);
+    fetch();
+    end();
+  }
+
+  else if (dc.accessType == stack && dc.addressingMode == push) {
+    readFrom(PC); // Discarded.
+    end();
+    begin(2);
+    writeTo(0x100 + S, (dc.instructionType == PHA) ? A : getP(true));
+    end();
+    begin(0);
+    --S;
+    fetch();
+    end();
+  }
+
+  else if (dc.accessType == stack && dc.addressingMode == pull) {
+    readFrom(PC); // Discarded.
+    end();
+    begin(2);
+    readFrom(0x100 + S); // Discarded.
+    end();
+    begin(3);
+    readFrom(0x100 + ++S);
+    end();
+    begin(0);
+    if (dc.instructionType == PLA) {
+      setNZ(A = dataBus);
+    } else {
+      P = dataBus;
+    }
+    fetch();
+    end();
+  }
+
+  else if (dc.instructionType == BRK) {
+    // The lines can change during the sequence: sample them at each cycle
+    // as cycle() does.
+    auto vector = [&]() -> uint16_t {
+      return resetLine ? 0xfffc : (!irqLine && nmiLine) ? 0xfffa : 0xfffe;
+    };
+    fetch(); // Discarded.
+    end();
+    begin(2);
+    if (!resetLine) {
+      writeTo(0x100 + S, (PC >> 8) & 0xff);
+    } else {
+      readFrom(0x100 + S);
+    }
+    end();
+    begin(3);
+    if (!resetLine) {
+      writeTo(0x100 + uint8_t(S - 1), PC & 0xff);
+    } else {
+      readFrom(0x100 + uint8_t(S - 1));
+    }
+    end();
+    begin(4);
+    if (!resetLine) {
+      bool b = !(resetLine || irqLine || nmiLine); // b flag = software interrupt
+      writeTo(0x100 + uint8_t(S - 2), getP(b));
+    } else {
+      readFrom(0x100 + uint8_t(S - 2));
+    }
+    end();
+    begin(5);
+    S -= 3;
+    readFrom(vector());
+    P[P.i] = true;
+    end();
+    begin(6);
+    AD = dataBus;
+    readFrom(vector() + 1);
+    resetLine = false;
+    end();
+    begin(0);
+    PC = (AD |= uint16_t(dataBus) << 8);
+    fetch();
+    end();
+  }
+
+  else if (dc.instructionType == RTS || dc.instructionType == RTI) {
+    fetch(); // Discarded.
+    end();
+    begin(2);
+    readFrom(0x100 + S++); // Discarded.
+    end();
+    begin(3);
+    readFrom(0x100 + S++);
+    end();
+    begin(4);
+    if (dc.instructionType == RTS) {
+      AD = dataBus;
+      readFrom(0x100 + S);
+      end();
+      begin(5);
+      PC = (AD |= uint16_t(dataBus) << 8);
+      fetch(); // Discarded.
+      end();
+      begin(0);
+    } else {
+      P = dataBus;
+      readFrom(0x100 + S++);
+      end();
+      begin(5);
+      AD = dataBus;
+      readFrom(0x100 + S);
+      end();
+      begin(0);
+      PC = (AD |= uint16_t(dataBus) << 8);
+    }
+    fetch();
+    end();
+  }
+
+  TP = 1;
+  return numCycles - firstCycle;
+}
@@ -8,6 +8,7 @@
 #ifndef M6502_hpp
 #define M6502_hpp
 
+#include "BinaryState.hpp"
 #include "json.hpp"
 #include <bitset>
 #include <cstddef>
@@ -106,8 +107,12 @@ protected:
 
   friend void to_json(nlohmann::json& j, const M6502State& s);
   friend void from_json(const nlohmann::json& j, M6502State& state);
+  friend void to_binary(BinaryWriter& w, const M6502State& s);
+  friend void from_binary(BinaryReader& r, M6502State& state);
 };
 
+class M6502Bus;
+
 class M6502 : public M6502State {
 public:
   /// Instruction menmonics.
@@ -186,6 +191,8 @@ public:
   // Operation.
   void reset();
   void cycle(bool busWasReady);
+  size_t step(M6502Bus& bus);
+  bool isAtInstructionBoundary() const { return TP == 1; }
   bool getVerbose() const;
   void setVerbose(bool x);
 
@@ -216,6 +223,25 @@ private:
   std::uint8_t xROR(std::uint8_t value);
   void readFrom(std::uint16_t addr);
   void writeTo(std::uint16_t addr, std::uint8_t value);
+  void executeImplied();
+  void executeRead(std::uint8_t value);
+  void executeWrite();
+  std::uint8_t executeModify(std::uint8_t value);
+  void executeModifyCompletion();
+  bool isBranchTaken() const;
+};
+
+/// The bus driven by the instruction-level engine `M6502::step()`.
+class M6502Bus {
+public:
+  virtual ~M6502Bus() = default;
+
+  /// Complete one bus cycle. The CPU address bus and RW line describe the
+  /// access; for a read, the bus must update the CPU data bus.
+  virtual void cycle(M6502& cpu) = 0;
+
+  /// Get the RDY line. When low, the CPU stalls on read cycles.
+  virtual bool isReady() const = 0;
 };
 
 // -------------------------------------------------------------------
@@ -8,6 +8,8 @@
 #include "M6532.hpp"
 #include "string.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace jigo;
 using json = nlohmann::json;
@@ -113,6 +115,36 @@ bool M6532::cycle(bool CS, bool RSnot, bool RW, uint16_t address, uint8_t& data)
   return false;
 }
 
+/// Simulate `numCycles` cycles in which the chip is not selected. This is
+/// equivalent to calling `cycle()` with `CS` false the same number of times,
+/// but the timer is updated in closed form.
+
+void M6532::advance(size_t numCycles) {
+  if (numCycles == 0) return;
+  if (!timerInterrupt) {
+    // INTIM is decremented at the cycles in which the prescaler counter is a
+    // multiple of the interval; the interrupt is raised when it underflows.
+    int unsigned const mask = timerInterval - 1;
+    size_t const wait = -timerCounter & mask;
+    size_t const numDecrements =
+        (numCycles > wait) ? (numCycles - 1 - wait) / timerInterval + 1 : 0;
+    if (numDecrements <= INTIM) {
+      INTIM -= static_cast<uint8_t>(numDecrements);
+      timerCounter += static_cast<int unsigned>(numCycles);
+      return;
+    }
+    size_t const numCyclesToUnderflow = wait + (size_t)INTIM * timerInterval + 1;
+    INTIM = 0xff;
+    timerInterrupt = true;
+    timerCounter += static_cast<int unsigned>(numCyclesToUnderflow);
+    numCycles -= numCyclesToUnderflow;
+  }
+  // After the interrupt, INTIM is decremented at every cycle down to 0x80.
+  size_t const numDecrements = min(numCycles, (size_t)(uint8_t)(INTIM - 0x80));
+  INTIM -= static_cast<uint8_t>(numDecrements);
+  timerCounter += static_cast<int unsigned>(numCycles);
+}
+
 void jigo::to_json(nlohmann::json& j, M6532State const& state) {
 #undef jput
 #define jput(x) j[#x] = state.x
@@ -154,6 +186,47 @@ void jigo::from_json(nlohmann::json const& j, M6532State& state) {
   jget(pa7InterruptEnabled);
 }
 
+void jigo::to_binary(BinaryWriter& w, M6532State const& state) {
+#define bput(x) to_binary(w, state.x)
+  bput(ram);
+  bput(portA);
+  bput(ORA);
+  bput(DDRA);
+  bput(portB);
+  bput(ORB);
+  bput(DDRB);
+  bput(timerInterval);
+  bput(timerCounter);
+  bput(INTIM);
+  bput(positiveEdgeDetect);
+  bput(timerInterrupt);
+  bput(timerInterruptEnabled);
+  bput(pa7Interrupt);
+  bput(pa7InterruptEnabled);
+#undef bput
+}
+
+/// Throws `std::invalid_argument` if the data is truncated.
+void jigo::from_binary(BinaryReader& r, M6532State& state) {
+#define bget(x) from_binary(r, state.x)
+  bget(ram);
+  bget(portA);
+  bget(ORA);
+  bget(DDRA);
+  bget(portB);
+  bget(ORB);
+  bget(DDRB);
+  bget(timerInterval);
+  bget(timerCounter);
+  bget(INTIM);
+  bget(positiveEdgeDetect);
+  bget(timerInterrupt);
+  bget(timerInterruptEnabled);
+  bget(pa7Interrupt);
+  bget(pa7InterruptEnabled);
+#undef bget
+}
+
 std::ostream& operator<<(std::ostream& os, M6532State::Register r) {
   auto n = registerNames.find(r);
   if (n != registerNames.end()) {
@@ -8,6 +8,7 @@
 #ifndef M6532_hpp
 #define M6532_hpp
 
+#include "BinaryState.hpp"
 #include "json.hpp"
 #include <cstddef>
 #include <cstdint>
@@ -69,6 +70,8 @@ public:
 
 void to_json(nlohmann::json& j, M6532State const& state);
 void from_json(nlohmann::json const& j, M6532State& state);
+void to_binary(BinaryWriter& w, M6532State const& state);
+void from_binary(BinaryReader& r, M6532State& state);
 
 /// M6532 coprocessor.
 class M6532 : public M6532State {
@@ -80,6 +83,7 @@ public:
   // Operation.
   void reset();
   bool cycle(bool CS, bool RSnot, bool RW, std::uint16_t address, std::uint8_t& data);
+  void advance(size_t numCycles);
   void writePortA(std::uint8_t a);
   void writePortB(std::uint8_t b);
   bool getIRQ() const;
@@ -6,7 +6,12 @@
 // the terms of the BSD license (see the COPYING file).
 
 #include "TIA.hpp"
+#include "TIAObservation.hpp"
+#include "TIASoundRecorder.hpp"
+#include "TIAStrobeHistogram.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cstring>
 #include <iostream>
 
@@ -188,22 +193,30 @@ std::ostream& operator<<(std::ostream& os, TIAState::Register r) {
 bool TIAState::operator==(const jigo::TIAState& s) const {
   return cmp(numCycles) && cmp(numFrames) && cmp(strobe) && cmp(D) && cmp(RDY) &&
          cmp(beamX) && cmp(beamY) && cmp(Hphasec) && cmp(HBnot) && cmp(SEC) &&
-         cmp(SECL) && cmp(VB) && cmp(VS) && cmp(HMC) && cmp(BEC) && cmp(MEC) &&
-         cmp(PEC) && cmp(PF) && cmp(B) && cmp(M) && cmp(P) && cmp(collisions) &&
-         cmp(ports);
+         cmp(SECL) && cmp(VB) && cmp(VS) && cmp(COLU) && cmp(HMC) && cmp(BEC) &&
+         cmp(MEC) && cmp(PEC) && cmp(PF) && cmp(B) && cmp(M) && cmp(P) &&
+         cmp(collisions) && cmp(ports) && cmp(audio);
 }
 #undef cmp
 
 inline uint32_t TIA::getColor(uint8_t value) const {
-  int color = (value >> 4) & 0xf;
-  int luminance = (value >> 1) & 0x7;
-  int offset = color * 8 + luminance;
+  return getPalette()[(value >> 1) & 0x7f];
+}
 
+/// Get the 128 ARGB colors of the current video standard. A colour register
+/// value `x` corresponds to the palette entry `x >> 1`.
+uint32_t const* TIA::getPalette() const {
   switch (videoStandard) {
-  case VideoStandard::NTSC: return ntsc_palette[offset];
-  case VideoStandard::PAL: return pal_palette[offset];
+  case VideoStandard::NTSC: return ntsc_palette;
+  case VideoStandard::PAL: return pal_palette;
   case VideoStandard::SECAM:
-  default: return secam_palette[offset];
+  default: return secam_palette;
+  }
+}
+
+void TIA::syncColors() {
+  for (int k = 0; k < 4; ++k) {
+    colors[k] = getColor(COLU[k]);
   }
 }
 
@@ -223,11 +236,115 @@ uint32_t const* TIA::getLastScreen() const {
   return screen[b];
 }
 
+/// Get the screen being drawn in the `indexed` render mode. Each pixel is
+/// the value of the colour register that generated it.
+uint8_t const* TIA::getCurrentIndexedScreen() const {
+  int b = (currentScreen + numScreenBuffers) % numScreenBuffers;
+  return indexedScreen[b];
+}
+
+/// Get the last screen drawn in the `indexed` render mode.
+uint8_t const* TIA::getLastIndexedScreen() const {
+  int b = (currentScreen - 1 + numScreenBuffers) % numScreenBuffers;
+  return indexedScreen[b];
+}
+
+/// Convert an indexed screen to ARGB colors using the palette of the
+/// current video standard.
+void TIA::convertIndexedScreen(uint32_t* argb, uint8_t const* indices) const {
+  auto palette = getPalette();
+  for (int i = 0; i < screenWidth * screenHeight; ++i) {
+    argb[i] = palette[indices[i] >> 1];
+  }
+}
+
 // -------------------------------------------------------------------
 // MARK: - Emulation
 // -------------------------------------------------------------------
 
+/// Simulate one CPU cycle (three colour clocks). The render mode determines
+/// how much of the video output is computed:
+///
+/// - `full`: the screen and the collision latches are updated.
+/// - `indexed`: like `full`, but the screen stores colour register values
+///   instead of ARGB colours (see `getLastIndexedScreen()`).
+/// - `collisionsOnly`: only the collision latches are updated; the screen
+///   buffers are left untouched.
+/// - `none`: neither is updated; games that read the collision latches
+///   will not behave correctly.
+
 void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
+  switch (renderMode) {
+  case RenderMode::full:
+    cycleWithRenderMode<RenderMode::full>(CS, Rw, address, data);
+    break;
+  case RenderMode::indexed:
+    cycleWithRenderMode<RenderMode::indexed>(CS, Rw, address, data);
+    break;
+  case RenderMode::collisionsOnly:
+    cycleWithRenderMode<RenderMode::collisionsOnly>(CS, Rw, address, data);
+    break;
+  case RenderMode::none:
+    cycleWithRenderMode<RenderMode::none>(CS, Rw, address, data);
+    break;
+  }
+}
+
+/// Return the number of CPU cycles that the TIA must be stepped, assuming
+/// no strobe, until SHB raises RDY. RDY is high at the end of the last of
+/// these cycles. This is the number of cycles left in a WSYNC stall.
+
+size_t TIA::getNumCyclesToReady() const {
+  auto h = Hphasec;
+  for (size_t n = 1;; ++n) {
+    bool SHB = false;
+    for (int cycle = 0; cycle < 3; ++cycle) {
+      h.cycle(true, false);
+      SHB |= h.getRES();
+    }
+    if (SHB) return n;
+  }
+}
+
+/// Set how much of the audio is emulated:
+///
+/// - `full`: the channel generators are clocked and their output is added
+///   to the audio streams (see `getSound()`).
+/// - `samplesOnly`: the generators are clocked, so that the audio state
+///   evolves exactly as in `full` mode, but no stream is produced.
+/// - `off`: the generators are not clocked. Writes to the audio registers
+///   still update the audio state.
+///
+/// When switching to `full`, the time elapsed in the other modes does not
+/// count towards the stream time.
+
+void TIA::setAudioMode(AudioMode x) {
+  if (x == AudioMode::full && audioMode != AudioMode::full) {
+    for (int c = 0; c < 2; ++c) {
+      sound[c].sync(numCycles);
+    }
+  }
+  audioMode = x;
+}
+
+inline void TIA::cycleSound(long long colorCycle) {
+  if (audioMode == AudioMode::full) {
+    sound[0].cycle(audio[0], colorCycle);
+    sound[1].cycle(audio[1], colorCycle);
+    // Drain the queues into the recorder before they overflow, even if the
+    // frame does not end.
+    if (soundRecorder && max(sound[0].getQueue().size(), sound[1].getQueue().size()) >=
+                             TIASoundQueue::capacity / 2) {
+      soundRecorder->update(sound[0], sound[1]);
+    }
+  } else if (audioMode == AudioMode::samplesOnly) {
+    audio[0].cycle();
+    audio[1].cycle();
+  }
+}
+
+template <TIA::RenderMode mode>
+void TIA::cycleWithRenderMode(bool CS, bool Rw, uint16_t address, uint8_t& data) {
   for (int cycle = 0; cycle < 3; ++cycle) {
     // When the CPU writes to the TIA, a corresponding register strobe
     // is triggered. The strobe is cleared in the middle of cycle=1,
@@ -310,9 +427,7 @@ void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
 
     // Audio logic
     if (Hphasec.getPhi2() && (Hphasec.get() == 9 || Hphasec.get() == 37)) {
-      for (int k = 0; k < 2; ++k) {
-        sound[k].cycle(int(numCycles));
-      }
+      cycleSound(numCycles);
     }
 
     // Playfield logic
@@ -334,17 +449,17 @@ void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
     // CLK falling edge, CKLP raising edge
     // -----------------------------------------------------------------
 
-    // A mask with the list of visible objects at this color clock.
-    bitset<6> visibility{0};
-    visibility[TIAObject::PF] = PF.get();
-    visibility[TIAObject::BL] = B.get();
-    visibility[TIAObject::M0] = M[0].get();
-    visibility[TIAObject::M1] = M[1].get();
-    visibility[TIAObject::P0] = P[0].get();
-    visibility[TIAObject::P1] = P[1].get();
-
     // Todo: Color updates applied at the last pixel should be effective? Why?
-    if (!VB) {
+    if (mode != RenderMode::none && !VB) {
+      // A mask with the list of visible objects at this color clock.
+      bitset<6> visibility{0};
+      visibility[TIAObject::PF] = PF.get();
+      visibility[TIAObject::BL] = B.get();
+      visibility[TIAObject::M0] = M[0].get();
+      visibility[TIAObject::M1] = M[1].get();
+      visibility[TIAObject::P0] = P[0].get();
+      visibility[TIAObject::P1] = P[1].get();
+
       // The Stella programming manual suggests to turn on VSYNC for 3 scanlines
       // and after thant blank for 37 more. Howevder, several games blank for
       // less, so we make a consevative choice here and cut out only 30 lines
@@ -362,10 +477,15 @@ void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
       collisions |= collisionAndColor;
 
       // The beam emits a color ony if HBLANK is off.
-      if (HBnot.get()) {
+      if (mode == RenderMode::full && HBnot.get()) {
         if (0 <= x && x < screenWidth && 0 <= y && y < screenHeight) {
           screen[currentScreen][screenWidth * y + x] = colors[collisionAndColor & 0xf];
         }
+      } else if (mode == RenderMode::indexed && HBnot.get()) {
+        if (0 <= x && x < screenWidth && 0 <= y && y < screenHeight) {
+          indexedScreen[currentScreen][screenWidth * y + x] =
+              COLU[collisionAndColor & 0xf];
+        }
       }
     }
 
@@ -485,6 +605,9 @@ void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
       // The CPU writes to the TIA.
       strobe = reg;
       D = data;
+      if (strobeHistogram) {
+        strobeHistogram->record(strobe, beamX, beamY);
+      }
       switch (strobe) {
       case VSYNC: {
         if (D & 0x02) {
@@ -494,9 +617,27 @@ void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
             // VSYNC switches off
             beamY = 0;
             ++numFrames;
+            if (observation) {
+              if (mode == RenderMode::full) {
+                observation->processFrame(screen[currentScreen]);
+              } else if (mode == RenderMode::indexed) {
+                observation->processFrame(indexedScreen[currentScreen], getPalette());
+              }
+            }
+            if (soundRecorder) {
+              soundRecorder->update(sound[0], sound[1]);
+            }
+            if (strobeHistogram) {
+              strobeHistogram->endFrame();
+            }
             currentScreen = (currentScreen + 1) % numScreenBuffers;
-            int memorySize = screenWidth * screenHeight * sizeof(uint32_t);
-            memset(screen[currentScreen], 0, memorySize);
+            if (mode == RenderMode::full) {
+              int memorySize = screenWidth * screenHeight * sizeof(uint32_t);
+              memset(screen[currentScreen], 0, memorySize);
+            } else if (mode == RenderMode::indexed) {
+              int memorySize = screenWidth * screenHeight * sizeof(uint8_t);
+              memset(indexedScreen[currentScreen], 0, memorySize);
+            }
           }
           VS = false;
         }
@@ -530,17 +671,28 @@ void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
         MEC[1].clearHM();
         break;
       }
-        // Todo: serialize colors.
-      case COLUP0: colors[ColorPM0] = getColor(D); break;
-      case COLUP1: colors[ColorPM1] = getColor(D); break;
-      case COLUPF: colors[ColorPF] = getColor(D); break;
-      case COLUBK: colors[ColorBK] = getColor(D); break;
-      case AUDV0: sound[0].setAUDV(D); break;
-      case AUDV1: sound[1].setAUDV(D); break;
-      case AUDF0: sound[0].setAUDF(D); break;
-      case AUDF1: sound[1].setAUDF(D); break;
-      case AUDC0: sound[0].setAUDC(D); break;
-      case AUDC1: sound[1].setAUDC(D); break;
+      case COLUP0:
+        COLU[ColorPM0] = D;
+        colors[ColorPM0] = getColor(D);
+        break;
+      case COLUP1:
+        COLU[ColorPM1] = D;
+        colors[ColorPM1] = getColor(D);
+        break;
+      case COLUPF:
+        COLU[ColorPF] = D;
+        colors[ColorPF] = getColor(D);
+        break;
+      case COLUBK:
+        COLU[ColorBK] = D;
+        colors[ColorBK] = getColor(D);
+        break;
+      case AUDV0: audio[0].setAUDV(D); break;
+      case AUDV1: audio[1].setAUDV(D); break;
+      case AUDF0: audio[0].setAUDF(D); break;
+      case AUDF1: audio[1].setAUDF(D); break;
+      case AUDC0: audio[0].setAUDC(D); break;
+      case AUDC1: audio[1].setAUDC(D); break;
       case CXCLR: collisions = 0; break;
       default: break;
       }
@@ -548,6 +700,195 @@ void TIA::cycle(bool CS, bool Rw, uint16_t address, uint8_t& data) {
   }
 }
 
+// -------------------------------------------------------------------
+// MARK: - Fast scanline engine
+// -------------------------------------------------------------------
+
+/// Simulate `numCPUCycles` CPU cycles during which the CPU does not access
+/// the TIA. This is equivalent to calling `cycle()` with `CS` false the same
+/// number of times, but it is faster for quiescent spans, i.e. spans where
+/// no strobe is pending and no HMOVE is in progress. These are simulated
+/// one object at a time and the pixels are then composed using the
+/// collision and colour table; the other spans fall back to `cycle()`.
+/// Quiescent spans that draw no pixels, such as during VBLANK, are further
+/// fast-forwarded a scanline at a time (see `cycleBlankedLines()`).
+
+void TIA::advance(size_t numCPUCycles) {
+  switch (renderMode) {
+  case RenderMode::full: advanceWithRenderMode<RenderMode::full>(numCPUCycles); break;
+  case RenderMode::indexed:
+    advanceWithRenderMode<RenderMode::indexed>(numCPUCycles);
+    break;
+  case RenderMode::collisionsOnly:
+    advanceWithRenderMode<RenderMode::collisionsOnly>(numCPUCycles);
+    break;
+  case RenderMode::none: advanceWithRenderMode<RenderMode::none>(numCPUCycles); break;
+  }
+}
+
+/// Check whether the next colour clocks can be simulated without strobes
+/// and extra motion clocks.
+bool TIA::isQuiescent() const {
+  return strobe == VOID && SEC.isIdle() && HMC == 0 && BEC.isIdle() &&
+         MEC[0].isIdle() && MEC[1].isIdle() && PEC[0].isIdle() && PEC[1].isIdle();
+}
+
+template <TIA::RenderMode mode> void TIA::advanceWithRenderMode(size_t numCPUCycles) {
+  uint8_t data = 0;
+  while (numCPUCycles > 0) {
+    if (isQuiescent() && numCPUCycles >= 2 * 76 &&
+        (mode == RenderMode::collisionsOnly || mode == RenderMode::none || VB)) {
+      numCPUCycles -= cycleBlankedLines<mode>(numCPUCycles);
+    } else if (isQuiescent()) {
+      // Simulate at most a scanline at a time.
+      size_t n = min(numCPUCycles, (size_t)76);
+      cycleQuiescentSpan<mode>(3 * static_cast<int>(n));
+      numCPUCycles -= n;
+    } else {
+      cycleWithRenderMode<mode>(false, true, 0, data);
+      numCPUCycles--;
+    }
+  }
+}
+
+template <TIA::RenderMode mode> void TIA::cycleQuiescentSpan(int numClocks) {
+  constexpr int maxNumClocks = 3 * 76;
+  assert(numClocks <= maxNumClocks);
+  uint8_t motionClock[maxNumClocks];
+  uint8_t visibility[maxNumClocks];
+  uint8_t right[maxNumClocks];
+  int pixel[maxNumClocks];
+  bool const draw = (mode != RenderMode::none) && !VB;
+
+  // Pass 1: the horizontal timing and the playfield, as well as the other
+  // logic clocked by the horizontal counter. As SEC and HMC are idle, the
+  // HM and extra clocks logic is a no-op.
+  for (int k = 0; k < numClocks; ++k) {
+    Hphasec.cycle(true, false);
+    auto const SHB = Hphasec.getRES();
+    if (SHB && Hphasec.getPhi2()) {
+      beamX = 0;
+      ++beamY;
+    }
+    SECL &= !SHB;
+    HBnot.cycle(Hphasec, (Hphasec.get() == 16 + 2 * SECL), SHB);
+    RDY |= SHB;
+    ports.cycle(Hphasec);
+    if (Hphasec.getPhi2() && (Hphasec.get() == 9 || Hphasec.get() == 37)) {
+      cycleSound(numCycles);
+    }
+    PF.cycle(Hphasec);
+    motionClock[k] = HBnot.get();
+    if (draw) {
+      int x = beamX - 68;
+      int y = beamY - topMargin;
+      bool visible =
+          HBnot.get() && 0 <= x && x < screenWidth && 0 <= y && y < screenHeight;
+      visibility[k] = PF.get() << TIAObject::PF;
+      right[k] = (x >= 80);
+      pixel[k] = visible ? screenWidth * y + x : -1;
+    }
+    ++numCycles;
+    ++beamX;
+  }
+
+  // Pass 2: each visual object on its own, using local copies so that the
+  // compiler can keep their state in registers. Missiles depend on their
+  // player for RESMP and are simulated together with it.
+  {
+    auto b = B;
+    for (int k = 0; k < numClocks; ++k) {
+      if (draw) visibility[k] |= b.get() << TIAObject::BL;
+      b.cycle(motionClock[k], false);
+    }
+    B = b;
+  }
+  for (int i = 0; i < 2; ++i) {
+    auto m = M[i];
+    auto p = P[i];
+    for (int k = 0; k < numClocks; ++k) {
+      if (draw) {
+        visibility[k] |= (m.get() << (TIAObject::M0 + i)) |
+                         (p.get() << (TIAObject::P0 + i));
+      }
+      m.cycle(motionClock[k], false, p);
+      p.cycle(motionClock[k], false);
+    }
+    M[i] = m;
+    P[i] = p;
+  }
+
+  // Pass 3: collisions and colours.
+  if (draw) {
+    auto const table = tables.collisionAndColorTable + 64 * 3 * PF.getPFP();
+    int const score = PF.getSCORE();
+    int latched = 0;
+    for (int k = 0; k < numClocks; ++k) {
+      int collisionAndColor = table[64 * (score * (1 + right[k])) + visibility[k]];
+      latched |= collisionAndColor;
+      if (pixel[k] >= 0) {
+        if (mode == RenderMode::full) {
+          screen[currentScreen][pixel[k]] = colors[collisionAndColor & 0xf];
+        } else if (mode == RenderMode::indexed) {
+          indexedScreen[currentScreen][pixel[k]] = COLU[collisionAndColor & 0xf];
+        }
+      }
+    }
+    collisions |= latched;
+  }
+}
+
+/// Simulate whole scanlines out of a quiescent span of `numCPUCycles` CPU
+/// cycles in which no pixels are drawn, and return the number of CPU cycles
+/// simulated. The first scanline is simulated normally. If it leaves the
+/// horizontal timing and the visual objects as they were, then so do the
+/// following ones, which also latch the same collisions. These are thus
+/// skipped, except for advancing the counters and for the once-per-line
+/// updates of the ports and of the audio, which happen at the same clocks
+/// in each line.
+
+template <TIA::RenderMode mode> size_t TIA::cycleBlankedLines(size_t numCPUCycles) {
+  constexpr int lineNumClocks = 3 * 76;
+  assert(numCPUCycles >= 2 * 76);
+  auto const lastHphasec = Hphasec;
+  auto const lastHBnot = HBnot;
+  auto const lastBeamX = beamX;
+  auto const lastSECL = SECL;
+  auto const lastPF = PF;
+  auto const lastB = B;
+  auto const lastM = M;
+  auto const lastP = P;
+  cycleQuiescentSpan<mode>(lineNumClocks);
+  if (!(Hphasec == lastHphasec && HBnot == lastHBnot && beamX == lastBeamX &&
+        SECL == lastSECL && PF == lastPF && B == lastB && M == lastM && P == lastP)) {
+    return 76;
+  }
+
+  // Find the clocks in the line at which the ports and the audio are updated.
+  int soundClocks[2];
+  int numSoundClocks = 0;
+  auto h = Hphasec;
+  for (int k = 0; k < lineNumClocks; ++k) {
+    h.cycle(true, false);
+    if (h.getPhi2() && (h.get() == 9 || h.get() == 37)) {
+      soundClocks[numSoundClocks++] = k;
+    }
+  }
+  assert(numSoundClocks == 2);
+
+  // Skip the other lines.
+  size_t numLines = numCPUCycles / 76 - 1;
+  for (size_t l = 0; l < numLines; ++l) {
+    for (int s = 0; s < 2; ++s) {
+      cycleSound(numCycles + soundClocks[s]);
+    }
+    ports.cycleLine();
+    numCycles += lineNumClocks;
+  }
+  beamY += static_cast<int>(numLines);
+  return 76 * (numLines + 1);
+}
+
 // -------------------------------------------------------------------
 // MARK: - Serialize & deserialize state
 // -------------------------------------------------------------------
@@ -594,6 +935,7 @@ void jigo::to_json(nlohmann::json& j, TIAState const& state) {
   jput(SECL);
   jput(VB);
   jput(VS);
+  jput(COLU);
   jput(HMC);
   jput(BEC);
   jput(MEC);
@@ -604,6 +946,7 @@ void jigo::to_json(nlohmann::json& j, TIAState const& state) {
   jput(P);
   jput(collisions);
   jput(ports);
+  jput(audio);
 #undef jput
 }
 
@@ -622,6 +965,9 @@ void jigo::from_json(nlohmann::json const& j, TIAState& state) {
   jget(SECL);
   jget(VB);
   jget(VS);
+  if (j.count("COLU")) {
+    jget(COLU);
+  }
   jget(HMC);
   jget(BEC);
   jget(MEC);
@@ -632,5 +978,71 @@ void jigo::from_json(nlohmann::json const& j, TIAState& state) {
   jget(P);
   jget(collisions);
   jget(ports);
+  if (j.count("audio")) {
+    jget(audio);
+  }
 #undef jget
 }
+
+void jigo::to_binary(BinaryWriter& w, TIAState const& state) {
+#define bput(x) to_binary(w, state.x)
+  bput(videoStandard);
+  bput(numCycles);
+  bput(numFrames);
+  bput(strobe);
+  bput(D);
+  bput(RDY);
+  bput(beamX);
+  bput(beamY);
+  bput(Hphasec);
+  bput(HBnot);
+  bput(SEC);
+  bput(SECL);
+  bput(VB);
+  bput(VS);
+  bput(COLU);
+  bput(HMC);
+  bput(BEC);
+  bput(MEC);
+  bput(PEC);
+  bput(PF);
+  bput(B);
+  bput(M);
+  bput(P);
+  bput(collisions);
+  bput(ports);
+  bput(audio);
+#undef bput
+}
+
+/// Throws `std::invalid_argument` if the data is truncated.
+void jigo::from_binary(BinaryReader& r, TIAState& state) {
+#define bget(x) from_binary(r, state.x)
+  bget(videoStandard);
+  bget(numCycles);
+  bget(numFrames);
+  bget(strobe);
+  bget(D);
+  bget(RDY);
+  bget(beamX);
+  bget(beamY);
+  bget(Hphasec);
+  bget(HBnot);
+  bget(SEC);
+  bget(SECL);
+  bget(VB);
+  bget(VS);
+  bget(COLU);
+  bget(HMC);
+  bget(BEC);
+  bget(MEC);
+  bget(PEC);
+  bget(PF);
+  bget(B);
+  bget(M);
+  bget(P);
+  bget(collisions);
+  bget(ports);
+  bget(audio);
+#undef bget
+}
@@ -25,6 +25,10 @@
 
 namespace jigo {
 
+class TIAObservation;
+class TIASoundRecorder;
+class TIAStrobeHistogram;
+
 constexpr auto TIA_NTSC_COLOR_CLOCK_RATE = 3.579545e6;
 constexpr auto TIA_PAL_COLOR_CLOCK_RATE = 3.546894e6;
 
@@ -89,6 +93,7 @@ struct TIAState {
   bool SECL{};
   bool VB{}; // VBLANK latch.
   bool VS{}; // VSYNC latch.
+  std::array<std::uint8_t, 4> COLU{}; // COLUBK, COLUPF, COLUP0, COLUP1.
 
   // Extra motion clocks.
   int HMC{};
@@ -105,6 +110,9 @@ struct TIAState {
 
   // IO ports.
   TIAPorts ports;
+
+  // Audio.
+  std::array<TIASoundState, 2> audio{};
 };
 
 // -----------------------------------------------------------------
@@ -116,13 +124,21 @@ public:
   // Lifecycle.
   TIA& operator=(TIAState const& s) {
     TIAState::operator=(s);
+    syncColors();
     return *this;
   }
   TIA& operator=(TIA const&) = delete;
 
   // Operate.
   void cycle(bool CS, bool Rw, std::uint16_t address, std::uint8_t& data);
+  void advance(size_t numCPUCycles);
+  size_t getNumCyclesToReady() const;
   void reset();
+
+  // Configure rendering.
+  enum class RenderMode : int { full, indexed, collisionsOnly, none };
+  void setRenderMode(RenderMode x) { renderMode = x; }
+  RenderMode getRenderMode() const { return renderMode; }
   uint32_t getColor(uint8_t value) const;
   void setVerbose(bool x) { verbose = x; }
   bool getVerbose() const { return verbose; }
@@ -134,21 +150,52 @@ public:
   static float constexpr pixelAspectRatio = 1.8f;
   std::uint32_t const* getCurrentScreen() const;
   std::uint32_t const* getLastScreen() const;
+  std::uint8_t const* getCurrentIndexedScreen() const;
+  std::uint8_t const* getLastIndexedScreen() const;
+  std::uint32_t const* getPalette() const;
+  void convertIndexedScreen(std::uint32_t* argb, std::uint8_t const* indices) const;
   VideoStandard getVideoStandard() const { return videoStandard; }
-  void setVideoStandard(VideoStandard x) { videoStandard = x; }
+  void setVideoStandard(VideoStandard x) {
+    videoStandard = x;
+    syncColors();
+  }
   std::array<int, 2> getScreenBounds() const;
+  void setObservation(TIAObservation* x) { observation = x; }
+  TIAObservation* getObservation() const { return observation; }
+  void setSoundRecorder(TIASoundRecorder* x) { soundRecorder = x; }
+  TIASoundRecorder* getSoundRecorder() const { return soundRecorder; }
+  void setStrobeHistogram(TIAStrobeHistogram* x) { strobeHistogram = x; }
+  TIAStrobeHistogram* getStrobeHistogram() const { return strobeHistogram; }
 
   // Access the audio.
+  enum class AudioMode : int { off, samplesOnly, full };
+  void setAudioMode(AudioMode x);
+  AudioMode getAudioMode() const { return audioMode; }
   TIASound const& getSound(int channel) { return sound[channel]; }
 
 private:
+  template <RenderMode mode>
+  void cycleWithRenderMode(bool CS, bool Rw, std::uint16_t address, std::uint8_t& data);
+  template <RenderMode mode> void advanceWithRenderMode(size_t numCPUCycles);
+  template <RenderMode mode> void cycleQuiescentSpan(int numClocks);
+  template <RenderMode mode> size_t cycleBlankedLines(size_t numCPUCycles);
+  bool isQuiescent() const;
+  void cycleSound(long long colorCycle);
+
+  void syncColors();
+
   // Transient.
+  RenderMode renderMode{RenderMode::full};
+  AudioMode audioMode{AudioMode::full};
+  TIAObservation* observation{nullptr};
+  TIASoundRecorder* soundRecorder{nullptr};
+  TIAStrobeHistogram* strobeHistogram{nullptr};
   TIASound sound[2];
   std::uint32_t colors[4];
-  unsigned int collisions;
   static int constexpr numScreenBuffers = 3;
   int currentScreen;
   std::uint32_t screen[numScreenBuffers][screenWidth * screenHeight];
+  std::uint8_t indexedScreen[numScreenBuffers][screenWidth * screenHeight];
   int verbose;
 
 protected:
@@ -162,6 +209,8 @@ void to_json(nlohmann::json& j, const TIAState::VideoStandard& p);
 void from_json(const nlohmann::json& j, TIAState::VideoStandard& p);
 void to_json(nlohmann::json& j, TIAState const& state);
 void from_json(nlohmann::json const& j, TIAState& state);
+void to_binary(BinaryWriter& w, TIAState const& state);
+void from_binary(BinaryReader& r, TIAState& state);
 } // namespace jigo
 
 std::ostream& operator<<(std::ostream& os, jigo::TIA::Register r);
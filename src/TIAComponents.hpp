@@ -8,6 +8,7 @@
 #ifndef TIAComponents_h
 #define TIAComponents_h
 
+#include "BinaryState.hpp"
 #include "json.hpp"
 #include <algorithm>
 #include <array>
@@ -18,9 +19,13 @@
 
 #undef jput
 #undef jget
+#undef bput
+#undef bget
 #undef cmp
 #define jput(m) j[#m] = x.m
 #define jget(m) x.m = j[#m]
+#define bput(m) to_binary(w, x.m)
+#define bget(m) from_binary(r, x.m)
 #define cmp(x) (x == rhs.x)
 
 namespace jigo {
@@ -71,6 +76,16 @@ public:
     x.RESL = j[1].get<bool>();
   }
 
+  friend void to_binary(BinaryWriter& w, TIADualPhase const& x) {
+    bput(phase);
+    bput(RESL);
+  }
+
+  friend void from_binary(BinaryReader& r, TIADualPhase& x) {
+    bget(phase);
+    bget(RESL);
+  }
+
 protected:
   int phase{};
   bool RESL{};
@@ -100,6 +115,10 @@ public:
 
   friend void from_json(nlohmann::json const& j, TIADelay<T>& x) { x.value = j; }
 
+  friend void to_binary(BinaryWriter& w, TIADelay<T> const& x) { bput(value); }
+
+  friend void from_binary(BinaryReader& r, TIADelay<T>& x) { bget(value); }
+
 protected:
   std::array<T, 2> value{};
 };
@@ -154,6 +173,20 @@ public:
     x.RES = j[3].get<bool>();
   }
 
+  friend void to_binary(BinaryWriter& w, TIADualPhaseAndCounterFast<maxCount> const& x) {
+    bput(phase);
+    bput(RESL);
+    bput(C);
+    bput(RES);
+  }
+
+  friend void from_binary(BinaryReader& r, TIADualPhaseAndCounterFast<maxCount>& x) {
+    bget(phase);
+    bget(RESL);
+    bget(C);
+    bget(RES);
+  }
+
 protected:
   int C{};
   bool RES{};
@@ -187,6 +220,16 @@ public:
     jget(RES);
   }
 
+  friend void to_binary(BinaryWriter& w, TIACounter const& x) {
+    bput(count);
+    bput(RES);
+  }
+
+  friend void from_binary(BinaryReader& r, TIACounter& x) {
+    bget(count);
+    bget(RES);
+  }
+
 protected:
   TIADelay<int> count;
   TIADelay<bool> RES;
@@ -219,6 +262,17 @@ public:
     from_json(j["phase"], static_cast<TIADualPhase&>(x));
     from_json(j["C"], static_cast<TIACounter<maxCount>&>(x));
   }
+
+  friend void to_binary(BinaryWriter& w,
+                        TIADualPhaseAndCounterExplicit<maxCount> const& x) {
+    to_binary(w, static_cast<TIADualPhase const&>(x));
+    to_binary(w, static_cast<TIACounter<maxCount> const&>(x));
+  }
+
+  friend void from_binary(BinaryReader& r, TIADualPhaseAndCounterExplicit<maxCount>& x) {
+    from_binary(r, static_cast<TIADualPhase&>(x));
+    from_binary(r, static_cast<TIACounter<maxCount>&>(x));
+  }
 };
 
 #if TIA_FAST
@@ -247,6 +301,7 @@ public:
   }
 
   bool get() const { return SEC[1]; }
+  bool isIdle() const { return !SEC[0] && !SEC[1] && !HMOVEL; }
 
   bool operator==(TIASEC const& rhs) const { return cmp(SEC) & cmp(HMOVEL); }
 
@@ -259,6 +314,16 @@ public:
     x.HMOVEL = j[1].get<decltype(HMOVEL)>();
   }
 
+  friend void to_binary(BinaryWriter& w, TIASEC const& x) {
+    bput(SEC);
+    bput(HMOVEL);
+  }
+
+  friend void from_binary(BinaryReader& r, TIASEC& x) {
+    bget(SEC);
+    bget(HMOVEL);
+  }
+
 protected:
   std::array<bool, 2> SEC{};
   bool HMOVEL{};
@@ -283,6 +348,7 @@ public:
   void clearHM() { HM = 8; }
   bool get(TIADualPhase const& phase) const { return getENA() & phase.getPhi1(); }
   bool getENA() const { return ENA[1]; }
+  bool isIdle() const { return !ENA[0] && !ENA[1]; }
 
   bool operator==(TIAExtraClock const& rhs) const { return cmp(ENA) && cmp(HM); }
 
@@ -294,6 +360,16 @@ public:
     x.HM = j[1].get<decltype(HM)>();
   }
 
+  friend void to_binary(BinaryWriter& w, TIAExtraClock const& x) {
+    bput(ENA);
+    bput(HM);
+  }
+
+  friend void from_binary(BinaryReader& r, TIAExtraClock& x) {
+    bget(ENA);
+    bget(HM);
+  }
+
 protected:
   std::array<bool, 2> ENA{};
   int HM{};
@@ -364,6 +440,26 @@ public:
     jget(PFP);
   }
 
+  friend void to_binary(BinaryWriter& w, TIAPlayField const& x) {
+    bput(PF);
+    bput(PFreg);
+    bput(mask);
+    bput(maskr);
+    bput(REF);
+    bput(SCORE);
+    bput(PFP);
+  }
+
+  friend void from_binary(BinaryReader& r, TIAPlayField& x) {
+    bget(PF);
+    bget(PFreg);
+    bget(mask);
+    bget(maskr);
+    bget(REF);
+    bget(SCORE);
+    bget(PFP);
+  }
+
 protected:
   static struct Tables {
     Tables() {
@@ -476,6 +572,29 @@ public:
     x.sync();
   }
 
+  friend void to_binary(BinaryWriter& w, TIAPlayerFast const& x) {
+    bput(PC);
+    bput(START);
+    bput(SC);
+    bput(GRP);
+    bput(NUSIZ);
+    bput(VDELP);
+    bput(ENA);
+    bput(REFL);
+  }
+
+  friend void from_binary(BinaryReader& r, TIAPlayerFast& x) {
+    bget(PC);
+    bget(START);
+    bget(SC);
+    bget(GRP);
+    bget(NUSIZ);
+    bget(VDELP);
+    bget(ENA);
+    bget(REFL);
+    x.sync();
+  }
+
 protected:
   static struct Tables {
     int start[8][40];
@@ -591,6 +710,28 @@ public:
     jget(REFL);
   }
 
+  friend void to_binary(BinaryWriter& w, TIAPlayerExplicit const& x) {
+    bput(phasec);
+    bput(START);
+    bput(SC);
+    bput(GRP);
+    bput(NUSIZ);
+    bput(VDELP);
+    bput(ENA);
+    bput(REFL);
+  }
+
+  friend void from_binary(BinaryReader& r, TIAPlayerExplicit& x) {
+    bget(phasec);
+    bget(START);
+    bget(SC);
+    bget(GRP);
+    bget(NUSIZ);
+    bget(VDELP);
+    bget(ENA);
+    bget(REFL);
+  }
+
 protected:
   TIADualPhaseAndCounter<39> phasec;
   TIADelay<int> START;
@@ -667,6 +808,25 @@ public:
     x.sync();
   }
 
+  friend void to_binary(BinaryWriter& w, TIAMissileFast const& x) {
+    bput(MC);
+    bput(START);
+    bput(SIZ);
+    bput(ENAM);
+    bput(RESMP);
+    bput(counter);
+  }
+
+  friend void from_binary(BinaryReader& r, TIAMissileFast& x) {
+    bget(MC);
+    bget(START);
+    bget(SIZ);
+    bget(ENAM);
+    bget(RESMP);
+    bget(counter);
+    x.sync();
+  }
+
 protected:
   static struct Tables {
     bool start[8][40];
@@ -741,6 +901,24 @@ public:
     jget(START2);
   }
 
+  friend void to_binary(BinaryWriter& w, TIAMissileExplicit const& x) {
+    bput(MC);
+    bput(SIZ);
+    bput(ENAM);
+    bput(RESMP);
+    bput(START1);
+    bput(START2);
+  }
+
+  friend void from_binary(BinaryReader& r, TIAMissileExplicit& x) {
+    bget(MC);
+    bget(SIZ);
+    bget(ENAM);
+    bget(RESMP);
+    bget(START1);
+    bget(START2);
+  }
+
 protected:
   TIADualPhaseAndCounter<39> MC;
   int SIZ{};
@@ -812,6 +990,23 @@ public:
     x.sync();
   }
 
+  friend void to_binary(BinaryWriter& w, TIABallFast const& x) {
+    bput(BC);
+    bput(BLEN);
+    bput(BLSIZ);
+    bput(BLVD);
+    bput(counter);
+  }
+
+  friend void from_binary(BinaryReader& r, TIABallFast& x) {
+    bget(BC);
+    bget(BLEN);
+    bget(BLSIZ);
+    bget(BLVD);
+    bget(counter);
+    x.sync();
+  }
+
 protected:
   TIADualPhaseAndCounter<39> BC;
   std::array<bool, 2> BLEN{}; // In ENABL.
@@ -869,6 +1064,22 @@ public:
     jget(BLVD);
   }
 
+  friend void to_binary(BinaryWriter& w, TIABallExplicit const& x) {
+    bput(phasec);
+    bput(START2);
+    bput(BLEN);
+    bput(BLSIZ);
+    bput(BLVD);
+  }
+
+  friend void from_binary(BinaryReader& r, TIABallExplicit& x) {
+    bget(phasec);
+    bget(START2);
+    bget(BLEN);
+    bget(BLSIZ);
+    bget(BLVD);
+  }
+
 protected:
   TIADualPhaseAndCounter<39> phasec;
   TIADelay<bool> START2;
@@ -886,16 +1097,20 @@ public:
   TIA_FORCE_INLINE
   void cycle(TIADualPhaseAndCounter<56> const& Hphasec) {
     if (Hphasec.getPhi2() && Hphasec.get() == 0) {
-      // INPT0-3 RC circuits.
-      if (INPT0123Dumped) {
-        charges = {0};
-        std::fill(begin(INPT), begin(INPT) + 4, 0);
-      } else {
-        for (int k = 0; k < 4; ++k) {
-          charges[k] += chargingRates[k];
-          charges[k] = std::min(1.0f, std::max(0.f, charges[k]));
-          INPT[k] = (charges[k] >= 1.0f);
-        }
+      cycleLine();
+    }
+  }
+
+  // Update the INPT0-3 RC circuits, once per scanline.
+  void cycleLine() {
+    if (INPT0123Dumped) {
+      charges = {0};
+      std::fill(begin(INPT), begin(INPT) + 4, 0);
+    } else {
+      for (int k = 0; k < 4; ++k) {
+        charges[k] += chargingRates[k];
+        charges[k] = std::min(1.0f, std::max(0.f, charges[k]));
+        INPT[k] = (charges[k] >= 1.0f);
       }
     }
   }
@@ -946,6 +1161,24 @@ public:
     jget(INPT0123Dumped);
   }
 
+  friend void to_binary(BinaryWriter& w, TIAPorts const& x) {
+    bput(INPT);
+    bput(charges);
+    bput(chargingRates);
+    bput(I45);
+    bput(INPT45Latched);
+    bput(INPT0123Dumped);
+  }
+
+  friend void from_binary(BinaryReader& r, TIAPorts& x) {
+    bget(INPT);
+    bget(charges);
+    bget(chargingRates);
+    bget(I45);
+    bget(INPT45Latched);
+    bget(INPT0123Dumped);
+  }
+
 protected:
   std::array<bool, 6> INPT{};
   std::array<float, 4> chargingRates{};
@@ -968,5 +1201,7 @@ using TIAPlayer = TIAPlayerExplicit;
 
 #undef jput
 #undef jget
+#undef bput
+#undef bget
 #undef cmp
 #endif /* TIAComponents_h */
@@ -0,0 +1,197 @@
+// TIAObservation.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "TIAObservation.hpp"
+#include "TIA.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace std;
+using namespace jigo;
+
+static int constexpr sourceWidth = TIA::screenWidth;
+static int constexpr sourceHeight = TIA::screenHeight;
+static int constexpr weightBits = 8;
+
+// -------------------------------------------------------------------
+// MARK: - Helpers
+// -------------------------------------------------------------------
+
+/// Compute the area-averaging taps to resize `sourceSize` pixels to
+/// `targetSize` pixels. The weights of each target pixel are fixed-point
+/// numbers summing exactly to `1 << weightBits`.
+void TIAObservation::Taps::make(int sourceSize, int targetSize) {
+  begin.clear();
+  count.clear();
+  index.clear();
+  weight.clear();
+  // Work in units of 1/targetSize source pixels so that all the bounds are
+  // integers: target pixel i covers [i * sourceSize, (i + 1) * sourceSize).
+  for (int i = 0; i < targetSize; ++i) {
+    int x0 = i * sourceSize;
+    int x1 = x0 + sourceSize;
+    begin.push_back((int)index.size());
+    uint32_t total = 0;
+    for (int j = x0 / targetSize; j * targetSize < x1; ++j) {
+      int overlap = min(x1, (j + 1) * targetSize) - max(x0, j * targetSize);
+      index.push_back(j);
+      weight.push_back((overlap << weightBits) / sourceSize);
+      total += weight.back();
+    }
+    weight.back() += (1u << weightBits) - total;
+    count.push_back((int)index.size() - begin.back());
+  }
+}
+
+static inline uint8_t luma(uint32_t argb) {
+  uint32_t r = (argb >> 16) & 0xff;
+  uint32_t g = (argb >> 8) & 0xff;
+  uint32_t b = argb & 0xff;
+  return static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+/// Create a pipeline producing `width` x `height` observations, in grayscale
+/// or RGB, optionally max-pooling each frame with the previous one.
+TIAObservation::TIAObservation(int width, int height, bool grayscale, bool maxPool)
+ : width(max(1, width)), height(max(1, height)), numChannels(grayscale ? 1 : 3),
+   maxPool(maxPool), output(nullptr), currentFrame(0) {
+  rowTaps.make(sourceHeight, this->height);
+  columnTaps.make(sourceWidth, this->width);
+  for (auto& frame : frames) {
+    frame.resize((size_t)sourceWidth * sourceHeight * numChannels);
+  }
+}
+
+/// Forget the previous frame, e.g. after loading a state.
+void TIAObservation::reset() {
+  for (auto& frame : frames) {
+    fill(frame.begin(), frame.end(), 0);
+  }
+}
+
+// -------------------------------------------------------------------
+// MARK: - Operate
+// -------------------------------------------------------------------
+
+/// Process a completed ARGB frame.
+void TIAObservation::processFrame(uint32_t const* argb) {
+  // Convert each row into a local buffer first: as it cannot alias the
+  // input, the compiler vectorizes the conversion without runtime checks.
+  uint8_t line[3 * sourceWidth];
+  uint8_t* frame = frames[currentFrame].data();
+  int const rowSize = sourceWidth * numChannels;
+  for (int y = 0; y < sourceHeight; ++y, argb += sourceWidth, frame += rowSize) {
+    if (numChannels == 1) {
+      for (int x = 0; x < sourceWidth; ++x) {
+        line[x] = luma(argb[x]);
+      }
+    } else {
+      for (int x = 0; x < sourceWidth; ++x) {
+        line[3 * x + 0] = static_cast<uint8_t>(argb[x] >> 16);
+        line[3 * x + 1] = static_cast<uint8_t>(argb[x] >> 8);
+        line[3 * x + 2] = static_cast<uint8_t>(argb[x]);
+      }
+    }
+    memcpy(frame, line, rowSize);
+  }
+  finishFrame();
+}
+
+/// Process a completed indexed frame. The `palette` is indexed by the colour
+/// register value divided by two, as returned by `TIA::getPalette()`.
+void TIAObservation::processFrame(uint8_t const* indices, uint32_t const* palette) {
+  uint8_t lut[3][128];
+  for (int k = 0; k < 128; ++k) {
+    if (numChannels == 1) {
+      lut[0][k] = luma(palette[k]);
+    } else {
+      lut[0][k] = static_cast<uint8_t>(palette[k] >> 16);
+      lut[1][k] = static_cast<uint8_t>(palette[k] >> 8);
+      lut[2][k] = static_cast<uint8_t>(palette[k]);
+    }
+  }
+  uint8_t line[3 * sourceWidth];
+  uint8_t* frame = frames[currentFrame].data();
+  int const rowSize = sourceWidth * numChannels;
+  for (int y = 0; y < sourceHeight; ++y, indices += sourceWidth, frame += rowSize) {
+    if (numChannels == 1) {
+      for (int x = 0; x < sourceWidth; ++x) {
+        line[x] = lut[0][indices[x] >> 1];
+      }
+    } else {
+      for (int x = 0; x < sourceWidth; ++x) {
+        int k = indices[x] >> 1;
+        line[3 * x + 0] = lut[0][k];
+        line[3 * x + 1] = lut[1][k];
+        line[3 * x + 2] = lut[2][k];
+      }
+    }
+    memcpy(frame, line, rowSize);
+  }
+  finishFrame();
+}
+
+/// Max-pool the current frame with the previous one and resize it into the
+/// output buffer. Resizing is separable: each output row is first
+/// accumulated over its source rows for all columns at once, in a local
+/// buffer that the compiler knows does not alias the frames, and then
+/// reduced over its source columns.
+void TIAObservation::finishFrame() {
+  uint8_t const* a = frames[currentFrame].data();
+  uint8_t const* b = frames[currentFrame ^ 1].data();
+  currentFrame ^= 1;
+  if (!output) return;
+
+  // Byte stores may alias anything, so copy the loop bounds and tables to
+  // locals to let the compiler keep them in registers.
+  int const numChannels = this->numChannels;
+  int const width = this->width;
+  int const rowSize = sourceWidth * numChannels;
+  bool const maxPool = this->maxPool;
+  int const* columnBegin = columnTaps.begin.data();
+  int const* columnCount = columnTaps.count.data();
+  int const* columnIndex = columnTaps.index.data();
+  uint32_t const* columnWeight = columnTaps.weight.data();
+  uint32_t acc[3 * sourceWidth];
+  uint8_t* out = output;
+  for (int y = 0; y < height; ++y) {
+    fill(acc, acc + rowSize, 0);
+    for (int t = rowTaps.begin[y], e = t + rowTaps.count[y]; t < e; ++t) {
+      uint32_t const w = rowTaps.weight[t];
+      uint8_t const* ra = a + (size_t)rowTaps.index[t] * rowSize;
+      if (maxPool) {
+        uint8_t const* rb = b + (size_t)rowTaps.index[t] * rowSize;
+        for (int i = 0; i < rowSize; ++i) {
+          acc[i] += w * max(ra[i], rb[i]);
+        }
+      } else {
+        for (int i = 0; i < rowSize; ++i) {
+          acc[i] += w * ra[i];
+        }
+      }
+    }
+    for (int x = 0; x < width; ++x) {
+      int const begin = columnBegin[x];
+      int const end = begin + columnCount[x];
+      for (int c = 0; c < numChannels; ++c) {
+        uint32_t sum = 0;
+        for (int t = begin; t < end; ++t) {
+          sum += columnWeight[t] * acc[columnIndex[t] * numChannels + c];
+        }
+        out[c] = static_cast<uint8_t>((sum + (1u << (2 * weightBits - 1))) >>
+                                      (2 * weightBits));
+      }
+      out += numChannels;
+    }
+  }
+}
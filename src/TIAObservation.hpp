@@ -0,0 +1,71 @@
+// TIAObservation.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef TIAObservation_hpp
+#define TIAObservation_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - TIA observation
+// -----------------------------------------------------------------
+
+/// Post-process the frames generated by the TIA into a caller-owned buffer.
+/// Each frame is optionally converted to grayscale, max-pooled with the
+/// previous frame, and resized to `width` x `height` pixels by area
+/// averaging. The output is stored as `[height, width, channels]` bytes,
+/// with one channel (grayscale) or three (RGB).
+///
+/// All loops run over contiguous byte or integer rows without branches, so
+/// that the compiler can vectorize them.
+class TIAObservation {
+public:
+  TIAObservation(int width = 84, int height = 84, bool grayscale = true,
+                 bool maxPool = true);
+
+  // Configure.
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  int getNumChannels() const { return numChannels; }
+  bool getMaxPool() const { return maxPool; }
+  size_t getSize() const { return (size_t)width * height * numChannels; }
+  void setOutput(std::uint8_t* output) { this->output = output; }
+  std::uint8_t* getOutput() const { return output; }
+
+  // Operate.
+  void processFrame(std::uint32_t const* argb);
+  void processFrame(std::uint8_t const* indices, std::uint32_t const* palette);
+  void reset();
+
+protected:
+  struct Taps {
+    void make(int sourceSize, int targetSize);
+    std::vector<int> begin;
+    std::vector<int> count;
+    std::vector<int> index;
+    std::vector<std::uint32_t> weight;
+  };
+  void finishFrame();
+
+  int width;
+  int height;
+  int numChannels;
+  bool maxPool;
+  std::uint8_t* output;
+  Taps rowTaps;
+  Taps columnTaps;
+  std::vector<std::uint8_t> frames[2];
+  int currentFrame;
+};
+
+} // namespace jigo
+
+#endif /* TIAObservation_hpp */
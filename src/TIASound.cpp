@@ -15,51 +15,24 @@
 using namespace jigo;
 using namespace std;
 
-TIASound::TIASound() {
-  reset();
+// -------------------------------------------------------------------
+// MARK: - TIASoundState
+// -------------------------------------------------------------------
+
+#define cmp(x) (x == s.x)
+bool TIASoundState::operator==(TIASoundState const& s) const {
+  return cmp(AUDC) && cmp(AUDF) && cmp(AUDV) && cmp(poly5) && cmp(poly4) &&
+         cmp(counter);
 }
+#undef cmp
 
-void TIASound::reset() {
-  AUDC = 0;
-  AUDF = 0;
-  AUDV = 0;
-  poly5 = 0x1f;
-  poly4 = 0xf;
-  counter = 0;
-  bufferEnd = 0;
-  // Resampler.
-  samples = {};
-  sampleCycles = {};
-  smoother = {};
-  lastCycleEmitted = 0;
-  emitPosition = 0;
-}
-
-void TIASound::setAUDC(std::uint8_t x) {
-  AUDC = (x & 0x0f);
-}
-void TIASound::setAUDF(std::uint8_t x) {
-  AUDF = (x & 0x1f);
-}
-void TIASound::setAUDV(std::uint8_t x) {
-  AUDV = (x & 0x0f);
-}
-void TIASound::setState(std::uint16_t x) {
+void TIASoundState::setState(std::uint16_t x) {
   poly5 = 0x1f & x;
   poly4 = 0x0f & (x >> 5);
 }
 
-void TIASound::cycle(long long colorCycle) {
-  // Add a sample to audio to buffer.
-  long long p = bufferEnd & bufferMask;
-  sampleCycles[p] = colorCycle;
-  if (poly4 & 0x8) {
-    samples[p] = AUDV;
-  } else {
-    samples[p] = 0;
-  }
-  ++bufferEnd;
-
+/// Clock the generator. This happens twice per scanline.
+void TIASoundState::cycle() {
   // Advance the AUDF counter.
   // The *previous* value of counter is compared to AUDC.
   // Note that this is a slight approximation, as the code is only correct if
@@ -76,7 +49,7 @@ void TIASound::cycle(long long colorCycle) {
 }
 
 // Helper.
-void TIASound::TP2Cycle() {
+void TIASoundState::TP2Cycle() {
   if (AUDC == 0000) {
     // Constant signal update.
     poly5 = (poly5 << 1) | 1;
@@ -162,95 +135,88 @@ void TIASound::TP2Cycle() {
   }
 }
 
-void TIASound::resample(uint8_t* begin, uint8_t* end, bool mix,
-                        double nominalRate) const {
-  assert(end >= begin);
-  auto numSamples = end - begin;
-
-  static constexpr double sos[2][6] = {
-      {0.001878908554386676, 0.0037578171087733507, 0.0018789085543866753, 1.0,
-       -1.9114274753486549, 0.9151870157068362},
-      {1.0, -1.913266482173494, 0.9151471579521344, 1.0, -1.9114274255653347,
-       0.9151870530425102},
-  };
-
-  // Get the latest simulated cycle.
-  auto cycle = sampleCycles[(bufferEnd - 1) & bufferMask];
-
-  // Smooth the latest simulated cycle to get a stable cycle rate.
-  double smoothCycle = cycle;
-  for (size_t k = 0; k < smoother.size(); ++k) {
-    auto w =
-        sos[k][3] * smoothCycle - sos[k][4] * smoother[k][0] - sos[k][5] * smoother[k][1];
-    smoothCycle = sos[k][0] * w + sos[k][1] * smoother[k][0] + sos[k][2] * smoother[k][1];
-    smoother[k] = {w, smoother[k][0]};
-  }
-
-  if (smoothCycle > cycle + 2 * 3.5e6 / 60 || smoothCycle < cycle - 2 * 3.5e6 / 60) {
-    double y = cycle;
-    double r = nominalRate;
-    for (size_t k = 0; k < smoother.size(); ++k) {
-      auto a = sos[k][3] / (1 + sos[k][4] + sos[k][5]);
-      auto b = (sos[k][5] - 1) / (1 + sos[k][4] + sos[k][5]);
-      auto p = sos[k][0] + sos[k][1] + sos[k][2];
-      auto gamma = a * r;
-
-      smoother[k][0] = a * y + b * gamma;
-      smoother[k][1] = smoother[k][0] - gamma;
-      y = p * smoother[k][0] + (sos[k][0] - sos[k][2]) * gamma;
-      r *= p * a;
-    }
-    smoothCycle = cycle;
-  }
-  // std::cout.precision(17) ;
-  // std::cout<< "[" << cycle << ", " << smoothCycle << "]," << std::endl ;
-
-  // Reproduce sound with a little delay to avoid tripping when overshooting a little.
-  smoothCycle = min((decltype(smoothCycle))cycle, smoothCycle - 2 * 3.5e6 / 60);
-
-  // The last cycle emitted cannot be greater than the largest cycle
-  // in the buffer. If this happens, it is because the simulation was reset.
-  lastCycleEmitted = min(lastCycleEmitted, (decltype(lastCycleEmitted))cycle);
+void jigo::to_json(nlohmann::json& j, TIASoundState const& state) {
+#define jput(x) j[#x] = state.x
+  jput(AUDC);
+  jput(AUDF);
+  jput(AUDV);
+  jput(poly5);
+  jput(poly4);
+  jput(counter);
+#undef jput
+}
 
-  // We would like to emit all available cycles up to smoothCycle. However,
-  // we cannot backtrack and we can exceed the largest cycle in the buffer,
-  // so we clamp the target cycle number.
-  auto targetCycle =
-      min((decltype(lastCycleEmitted))cycle, max(smoothCycle, lastCycleEmitted));
+void jigo::from_json(nlohmann::json const& j, TIASoundState& state) {
+#define jget(m) state.m = j[#m].get<decltype(state.m)>()
+  jget(AUDC);
+  jget(AUDF);
+  jget(AUDV);
+  jget(poly5);
+  jget(poly4);
+  jget(counter);
+#undef jget
+}
 
-  // We are going to emit cycles in the range [lastCycleEmitted, targetCycle).
-  // These cycles are uniformly distributed among audio samples.
-  auto nextCycleToEmit = lastCycleEmitted;
-  auto emitRate = (targetCycle - lastCycleEmitted) / (double)numSamples;
+void jigo::to_binary(BinaryWriter& w, TIASoundState const& state) {
+#define bput(x) to_binary(w, state.x)
+  bput(AUDC);
+  bput(AUDF);
+  bput(AUDV);
+  bput(poly5);
+  bput(poly4);
+  bput(counter);
+#undef bput
+}
 
-  // Make sure the current position in the ring buffer is valid.
-  emitPosition = min(emitPosition, bufferEnd);
-  emitPosition = max(emitPosition, bufferEnd - bufferSize + 1);
+void jigo::from_binary(BinaryReader& r, TIASoundState& state) {
+#define bget(x) from_binary(r, state.x)
+  bget(AUDC);
+  bget(AUDF);
+  bget(AUDV);
+  bget(poly5);
+  bget(poly4);
+  bget(counter);
+#undef bget
+}
 
-  // Resampling.
-  uint8_t sample = samples[emitPosition % bufferMask];
-  while (begin != end) {
-    while (true) {
-      auto p = emitPosition + 1;
-      if (p < bufferEnd && sampleCycles[p & bufferMask] <= nextCycleToEmit) {
-        sample = samples[p & bufferMask];
-        emitPosition = p;
-      } else {
-        break;
-      }
+// -------------------------------------------------------------------
+// MARK: - TIASound
+// -------------------------------------------------------------------
+
+/// Clock the generator `state` at the colour cycle `colorCycle`, adding
+/// an event to the audio stream if its output level changes.
+void TIASound::cycle(TIASoundState& state, long long colorCycle) {
+  // Advance the stream time. The colour cycle goes back on a reset or
+  // when a state is loaded, which is treated as no time passing.
+  auto time = streamTime.load(std::memory_order_relaxed);
+  time += max(colorCycle - lastColorCycle, 0LL);
+  lastColorCycle = colorCycle;
+
+  // Add an event to the audio stream if the output level changes. If the
+  // queue is full, try again at the next cycle, counting the overflow, as
+  // the event is then late. Long runs of the same level are split so that
+  // the time offsets fit the event.
+  uint8_t value = state.getValue();
+  if (value != lastValue) {
+    while (time - lastEventTime > TIASoundEvent::maxDelta &&
+           queue.push({TIASoundEvent::maxDelta, lastValue})) {
+      lastEventTime += TIASoundEvent::maxDelta;
     }
-    // Store.
-    int scaledSample = ((int)sample) << 3;
-    scaledSample += 128;
-    if (mix) {
-      int mixed = *begin;
-      *begin++ = (scaledSample + mixed) >> 1;
+    if (time - lastEventTime <= TIASoundEvent::maxDelta &&
+        queue.push({static_cast<uint32_t>(time - lastEventTime), value})) {
+      lastEventTime = time;
+      lastValue = value;
     } else {
-      *begin++ = scaledSample;
+      ++numOverflows;
     }
-    nextCycleToEmit += emitRate;
   }
+  streamTime.store(time, std::memory_order_release);
+  state.cycle();
+}
 
-  // Record which is the last emitted cycle for later.
-  lastCycleEmitted = targetCycle;
+/// Restart the stream clock at the colour cycle `colorCycle`, so that the
+/// cycles elapsed since the last call to `cycle()` do not count as stream
+/// time.
+void TIASound::sync(long long colorCycle) {
+  lastColorCycle = colorCycle;
 }
@@ -8,63 +8,148 @@
 #ifndef Atari2600Sound_hpp
 #define Atari2600Sound_hpp
 
+#include "BinaryState.hpp"
+#include "json.hpp"
 #include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 
 namespace jigo {
 
-class TIASound {
+// -----------------------------------------------------------------
+// MARK: - TIASoundQueue
+// -----------------------------------------------------------------
+
+/// A change of the output level of a sound channel, `delta` colour cycles
+/// after the previous change.
+struct TIASoundEvent {
+  std::uint32_t delta : 28;
+  std::uint32_t value : 4;
+  static constexpr std::uint32_t maxDelta = (1u << 28) - 1;
+};
+
+/// A lock-free queue of sound events with a single producer, the emulation
+/// thread, and a single consumer, such as an audio callback. The producer
+/// never blocks: if the queue is full, `push()` fails. The consumer side
+/// keeps track of the time and value of the last event popped, so that
+/// consumers can be swapped.
+class TIASoundQueue {
 public:
-  TIASound();
-  void cycle(long long colorCycle);
-  void setAUDC(std::uint8_t x);
-  void setAUDF(std::uint8_t x);
-  void setAUDV(std::uint8_t x);
-  void setState(std::uint16_t x);
-  void reset();
+  static constexpr size_t capacity = (1 << 13);
 
-  // Audio buffer.
-  static constexpr int bufferSize = (1 << 16);
-  static constexpr int bufferMask = bufferSize - 1;
-  inline std::uint8_t const* getBufferSamples() const;
-  inline long long const* getBufferSampleCycles() const;
-  inline long long getBufferEnd() const;
+  // Produce.
+  bool push(TIASoundEvent event);
 
-  // Audio buffer resampler.
-  void resample(uint8_t* begin, uint8_t* end, bool mix,
-                double nominalRate = 3.579545e6) const;
+  // Consume.
+  bool front(TIASoundEvent& event) const;
+  void pop();
+  size_t size() const;
+  long long getTime() const { return time; }
+  std::uint8_t getValue() const { return value; }
 
 protected:
-  std::uint8_t AUDC;
-  std::uint8_t AUDF;
-  std::uint8_t AUDV;
-  std::uint8_t poly5;
-  std::uint8_t poly4;
-  int counter;
-  long long bufferEnd;
-  std::array<std::uint8_t, bufferSize> samples;
-  std::array<long long, bufferSize> sampleCycles;
-
-  // Resampler.
-  static constexpr size_t smootherOrder = 2;
-  mutable std::array<std::array<double, 2>, smootherOrder> smoother;
-  mutable double lastCycleEmitted;
-  mutable long long emitPosition;
+  static constexpr size_t mask = capacity - 1;
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+  std::array<TIASoundEvent, capacity> events;
+  long long time{0};
+  std::uint8_t value{0};
+};
+
+// -----------------------------------------------------------------
+// MARK: - TIASoundState
+// -----------------------------------------------------------------
+
+/// The state of the generator of a sound channel. This is part of the TIA
+/// state, so that it is saved and restored with it.
+struct TIASoundState {
+  std::uint8_t AUDC{};
+  std::uint8_t AUDF{};
+  std::uint8_t AUDV{};
+  std::uint8_t poly5{0x1f};
+  std::uint8_t poly4{0x0f};
+  std::uint8_t counter{};
+
+  bool operator==(TIASoundState const& s) const;
+  void setAUDC(std::uint8_t x) { AUDC = (x & 0x0f); }
+  void setAUDF(std::uint8_t x) { AUDF = (x & 0x1f); }
+  void setAUDV(std::uint8_t x) { AUDV = (x & 0x0f); }
+  void setState(std::uint16_t x);
+  std::uint8_t getValue() const { return (poly4 & 0x8) ? AUDV : 0; }
+  void cycle();
 
 private:
   void TP2Cycle();
 };
 
-std::uint8_t const* TIASound::getBufferSamples() const {
-  return &samples[0];
+void to_json(nlohmann::json& j, TIASoundState const& state);
+void from_json(nlohmann::json const& j, TIASoundState& state);
+void to_binary(BinaryWriter& w, TIASoundState const& state);
+void from_binary(BinaryReader& r, TIASoundState& state);
+
+// -----------------------------------------------------------------
+// MARK: - TIASound
+// -----------------------------------------------------------------
+
+/// The audio stream of a sound channel. `cycle()` clocks the generator
+/// and adds an event to the stream when its output level changes.
+class TIASound {
+public:
+  void cycle(TIASoundState& state, long long colorCycle);
+  void sync(long long colorCycle);
+
+  // Audio stream. The events are timed in colour cycles of a stream time
+  // that, unlike the machine cycle count, never goes back (for example on a
+  // reset or when a state is loaded). See `TIASoundSynthesizer`. The
+  // overflows count the cycles in which a level change was delayed
+  // because the queue was full.
+  TIASoundQueue& getQueue() const { return queue; }
+  long long getStreamTime() const { return streamTime.load(std::memory_order_acquire); }
+  std::uint64_t getNumOverflows() const { return numOverflows; }
+
+protected:
+  // Producer.
+  mutable TIASoundQueue queue;
+  std::atomic<long long> streamTime{0};
+  long long lastColorCycle{0};
+  long long lastEventTime{0};
+  std::uint8_t lastValue{0};
+  std::uint64_t numOverflows{0};
+};
+
+// -----------------------------------------------------------------
+// MARK: - Inline members
+// -----------------------------------------------------------------
+
+/// Append an event. Called by the producer only.
+inline bool TIASoundQueue::push(TIASoundEvent event) {
+  auto h = head.load(std::memory_order_relaxed);
+  if (h - tail.load(std::memory_order_acquire) == capacity) return false;
+  events[h & mask] = event;
+  head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+/// Get the oldest event, if any. Called by the consumer only.
+inline bool TIASoundQueue::front(TIASoundEvent& event) const {
+  auto t = tail.load(std::memory_order_relaxed);
+  if (t == head.load(std::memory_order_acquire)) return false;
+  event = events[t & mask];
+  return true;
 }
 
-long long const* TIASound::getBufferSampleCycles() const {
-  return &sampleCycles[0];
+/// Remove the oldest event. Called by the consumer only after `front()`
+/// returned true.
+inline void TIASoundQueue::pop() {
+  auto t = tail.load(std::memory_order_relaxed);
+  time += events[t & mask].delta;
+  value = events[t & mask].value;
+  tail.store(t + 1, std::memory_order_release);
 }
 
-long long TIASound::getBufferEnd() const {
-  return bufferEnd;
+inline size_t TIASoundQueue::size() const {
+  return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
 }
 
 } // namespace jigo
@@ -0,0 +1,86 @@
+// TIASoundRecorder.cpp
+// Atari 2600 TIA sound emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "TIASoundRecorder.hpp"
+#include "TIASound.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+using namespace jigo;
+
+/// Create a recorder producing `sampleRate` samples per second of emulated
+/// time, for a TIA clocked at `clockRate` colour cycles per second.
+TIASoundRecorder::TIASoundRecorder(double sampleRate, double clockRate, bool floatSamples)
+ : synthesizer(sampleRate, clockRate), floatSamples(floatSamples), numSamples(0),
+   numOverflows(0), lastNumOverflows{UINT64_MAX, UINT64_MAX} {}
+
+/// Synthesize the audio simulated so far and append it to the recording.
+/// The events are consumed in steps that fit the synthesizer buffer, so
+/// that no sample is dropped.
+void TIASoundRecorder::update(TIASound const& channel0, TIASound const& channel1) {
+  // The overflows before the first update are not counted, as the queues
+  // may have filled up before the recorder was attached.
+  TIASound const* channels[2] = {&channel0, &channel1};
+  for (int c = 0; c < 2; ++c) {
+    auto n = channels[c]->getNumOverflows();
+    numOverflows += n - min(n, lastNumOverflows[c]);
+    lastNumOverflows[c] = n;
+  }
+  long long const end = min(channel0.getStreamTime(), channel1.getStreamTime());
+  while (true) {
+    long long const time = synthesizer.getMaxPullTime(channel0, channel1);
+    append(synthesizer.pull(channel0, channel1, time));
+    if (time >= end) break;
+  }
+}
+
+/// Read `n` samples from the synthesizer and append them to the recording.
+void TIASoundRecorder::append(size_t n) {
+  size_t const offset = data.size();
+  data.resize(offset + n * getSampleSize());
+  if (floatSamples) {
+    vector<float> samples(n);
+    synthesizer.read(samples.data(), n);
+    for (size_t k = 0; k < n; ++k) {
+      uint32_t x;
+      memcpy(&x, &samples[k], sizeof(x));
+      for (size_t b = 0; b < 4; ++b) {
+        data[offset + 4 * k + b] = static_cast<uint8_t>(x >> (8 * b));
+      }
+    }
+  } else {
+    vector<int16_t> samples(n);
+    synthesizer.read(samples.data(), n);
+    for (size_t k = 0; k < n; ++k) {
+      auto x = static_cast<uint16_t>(samples[k]);
+      data[offset + 2 * k + 0] = static_cast<uint8_t>(x);
+      data[offset + 2 * k + 1] = static_cast<uint8_t>(x >> 8);
+    }
+  }
+  numSamples += n;
+}
+
+/// Return the samples recorded since the last call and remove them from
+/// the recorder.
+vector<uint8_t> TIASoundRecorder::take() {
+  vector<uint8_t> result;
+  result.swap(data);
+  return result;
+}
+
+/// Discard the recording and restart from the sound events not yet
+/// consumed.
+void TIASoundRecorder::clear() {
+  synthesizer.clear();
+  data.clear();
+  numSamples = 0;
+  numOverflows = 0;
+  lastNumOverflows[0] = lastNumOverflows[1] = UINT64_MAX;
+}
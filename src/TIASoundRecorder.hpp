@@ -0,0 +1,70 @@
+// TIASoundRecorder.hpp
+// Atari 2600 TIA sound emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef TIASoundRecorder_hpp
+#define TIASoundRecorder_hpp
+
+#include "TIASoundSynthesizer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - TIA sound recorder
+// -----------------------------------------------------------------
+
+/// Render the TIA audio offline, for example to capture it to a file. The
+/// samples are synthesized as a function of the emulated cycle count only,
+/// without any real-time pacing, so that the same emulation always yields
+/// the same samples regardless of how fast it runs.
+///
+/// When attached to a TIA, the recorder is updated at the end of each frame,
+/// and whenever a sound queue is half full, and accumulates the new samples
+/// as 16-bit or 32-bit float PCM, little endian, which the caller collects
+/// with `take()`. No sample is dropped however long the interval between
+/// updates; if the queues overflowed anyway, for example because the
+/// recorder was attached to a TIA other than the one producing the sound,
+/// `getNumOverflows()` is nonzero. The recorder consumes the TIA sound
+/// queues, so it cannot be used along with another consumer.
+class TIASoundRecorder {
+public:
+  TIASoundRecorder(double sampleRate = 44100, double clockRate = 3.579545e6,
+                   bool floatSamples = false);
+
+  // Configure.
+  double getSampleRate() const { return synthesizer.getSampleRate(); }
+  double getClockRate() const { return synthesizer.getClockRate(); }
+  bool getFloatSamples() const { return floatSamples; }
+  size_t getSampleSize() const {
+    return floatSamples ? sizeof(float) : sizeof(std::int16_t);
+  }
+
+  // Operate.
+  void update(TIASound const& channel0, TIASound const& channel1);
+  std::vector<std::uint8_t> take();
+  size_t getNumBytes() const { return data.size(); }
+  long long getNumSamples() const { return numSamples; }
+  std::uint64_t getNumOverflows() const { return numOverflows; }
+  void clear();
+
+protected:
+  void append(size_t numSamples);
+
+  TIASoundSynthesizer synthesizer;
+  bool floatSamples;
+  std::vector<std::uint8_t> data;
+  long long numSamples;
+  std::uint64_t numOverflows;
+  std::uint64_t lastNumOverflows[2];
+};
+
+} // namespace jigo
+
+#endif /* TIASoundRecorder_hpp */
@@ -0,0 +1,254 @@
+// TIASoundSynthesizer.cpp
+// Atari 2600 TIA sound emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "TIASoundSynthesizer.hpp"
+#include "TIASound.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace jigo;
+
+static constexpr double pi = 3.14159265358979323846;
+
+/// Output amplitude of one unit of channel volume. With both channels at
+/// full volume, the steps span [-30/32, 30/32], which leaves some headroom
+/// for the ringing of the band-limited steps.
+static constexpr float amplitude = 1.0f / 32;
+
+/// Cutoff frequency of the band-limited steps, as a fraction of the sample
+/// rate.
+static constexpr double cutoff = 0.45;
+
+/// Cutoff frequency of the DC-removal filter in Hz.
+static constexpr double highPassCutoff = 20;
+
+// -------------------------------------------------------------------
+// MARK: - Tables
+// -------------------------------------------------------------------
+
+TIASoundSynthesizer::Tables const TIASoundSynthesizer::tables;
+
+/// Tabulate the differences of a band-limited unit step starting between
+/// taps `kernelWidth / 2 - 1` and `kernelWidth / 2`, at each sub-sample
+/// offset. These are a Blackman-windowed sinc, normalized so that the
+/// step height is exactly one.
+TIASoundSynthesizer::Tables::Tables() {
+  double const halfWidth = kernelWidth / 2;
+  for (int p = 0; p <= numPhases; ++p) {
+    double taps[kernelWidth];
+    double sum = 0;
+    for (int k = 0; k < kernelWidth; ++k) {
+      double t = k - (halfWidth - 1) - (double)p / numPhases;
+      double x = 2 * cutoff * t;
+      double sinc = (x == 0) ? 1 : sin(pi * x) / (pi * x);
+      double window = (abs(t) < halfWidth)
+                          ? 0.42 + 0.5 * cos(pi * t / halfWidth) +
+                                0.08 * cos(2 * pi * t / halfWidth)
+                          : 0;
+      taps[k] = sinc * window;
+      sum += taps[k];
+    }
+    for (int k = 0; k < kernelWidth; ++k) {
+      steps[p][k] = static_cast<float>(taps[k] / sum);
+    }
+  }
+}
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+/// Create a synthesizer producing `sampleRate` samples per second from a
+/// TIA clocked at `clockRate` colour cycles per second. The buffer holds a
+/// quarter of a second.
+TIASoundSynthesizer::TIASoundSynthesizer(double sampleRate, double clockRate)
+ : sampleRate(sampleRate), started(false),
+   buffer(static_cast<size_t>(sampleRate / 4) + kernelWidth) {
+  highPass = static_cast<float>(1 - exp(-2 * pi * highPassCutoff / sampleRate));
+  setClockRate(clockRate);
+  clear();
+}
+
+/// Set the number of colour cycles per second of audio. This can be scaled
+/// to play the emulation faster or slower.
+void TIASoundSynthesizer::setClockRate(double x) {
+  clockRate = x;
+  samplesPerCycle = sampleRate / clockRate;
+}
+
+/// Discard the buffered samples. The next call to `pull()` restarts from
+/// the events not yet consumed.
+void TIASoundSynthesizer::clear() {
+  started = false;
+  originTime = 0;
+  origin = 0;
+  fill(buffer.begin(), buffer.end(), 0.0f);
+  numAvailable = 0;
+  numUsed = 0;
+  level = 0;
+  dcLevel = 0;
+  output = 0;
+}
+
+// -------------------------------------------------------------------
+// MARK: - Operate
+// -------------------------------------------------------------------
+
+/// Consume the sound events of both channels up to the last simulated
+/// cycle, or up to the stream time `maxTime` if earlier, and return the
+/// number of samples available.
+size_t TIASoundSynthesizer::pull(TIASound const& channel0, TIASound const& channel1,
+                                 long long maxTime) {
+  TIASoundQueue* queues[2] = {&channel0.getQueue(), &channel1.getQueue()};
+  long long const time =
+      min(min(channel0.getStreamTime(), channel1.getStreamTime()), maxTime);
+  if (!started) {
+    started = true;
+    originTime = min(queues[0]->getTime(), queues[1]->getTime());
+    origin = 0;
+  }
+
+  // Merge the events of the two channels in time order, so that the steps
+  // are added at non-decreasing positions.
+  while (true) {
+    TIASoundEvent events[2];
+    long long times[2];
+    bool pending[2];
+    for (int c = 0; c < 2; ++c) {
+      pending[c] = queues[c]->front(events[c]) &&
+                   (times[c] = queues[c]->getTime() + events[c].delta) <= time;
+    }
+    if (!pending[0] && !pending[1]) break;
+    int c = (pending[0] && (!pending[1] || times[0] <= times[1])) ? 0 : 1;
+    int delta = events[c].value - queues[c]->getValue();
+    queues[c]->pop();
+    addStep(getPosition(times[c]), delta * amplitude);
+  }
+
+  // The samples before the current position are final.
+  double end = max(getPosition(time), 0.0);
+  if (end + kernelWidth > buffer.size()) {
+    drop(static_cast<size_t>(end) + kernelWidth - buffer.size());
+    end = max(getPosition(time), 0.0);
+  }
+  numAvailable = max(numAvailable, static_cast<size_t>(end));
+
+  // Move the origin to the current time to preserve the precision.
+  origin = getPosition(time);
+  originTime = time;
+  return numAvailable;
+}
+
+/// Get the latest stream time up to which `pull()` can consume the events
+/// without dropping samples, provided that the available samples are read
+/// first, which is about a quarter of a second after the last pull.
+long long TIASoundSynthesizer::getMaxPullTime(TIASound const& channel0,
+                                              TIASound const& channel1) const {
+  long long time = originTime;
+  double position = origin;
+  if (!started) {
+    time = min(channel0.getQueue().getTime(), channel1.getQueue().getTime());
+    position = 0;
+  }
+  double room = static_cast<double>(buffer.size() - kernelWidth - 1) - max(position, 0.0);
+  return time + max(static_cast<long long>(room / samplesPerCycle), 1LL);
+}
+
+/// Read up to `numSamples` samples and return their number. If fewer
+/// samples are available, the rest of the output is padded with the last
+/// sample.
+size_t TIASoundSynthesizer::read(float* samples, size_t numSamples) {
+  return readSamples(samples, numSamples);
+}
+
+size_t TIASoundSynthesizer::read(std::int16_t* samples, size_t numSamples) {
+  return readSamples(samples, numSamples);
+}
+
+// -------------------------------------------------------------------
+// MARK: - Helpers
+// -------------------------------------------------------------------
+
+/// Add a step of height `delta` at the sample `position`.
+void TIASoundSynthesizer::addStep(double position, float delta) {
+  if (delta == 0) return;
+  position = max(position, 0.0);
+  if (position + kernelWidth > buffer.size()) {
+    size_t n = static_cast<size_t>(position) + kernelWidth - buffer.size();
+    drop(n);
+    position -= n;
+  }
+  auto i = static_cast<size_t>(position);
+  auto phase = static_cast<int>((position - i) * numPhases + 0.5);
+  float const* step = tables.steps[phase];
+  float* out = &buffer[i];
+  for (int k = 0; k < kernelWidth; ++k) {
+    out[k] += delta * step[k];
+  }
+  numUsed = max(numUsed, i + kernelWidth);
+}
+
+static inline void store(float* sample, float x) {
+  *sample = x;
+}
+
+static inline void store(std::int16_t* sample, float x) {
+  x = min(max(x * 32767.0f, -32768.0f), 32767.0f);
+  *sample = static_cast<std::int16_t>(lrintf(x));
+}
+
+/// Integrate the first `numSamples` samples in the buffer, storing them into
+/// `samples` unless null, and remove them from the buffer.
+template <class T>
+size_t TIASoundSynthesizer::readSamples(T* samples, size_t numSamples) {
+  size_t const n = min(numSamples, min(numAvailable, buffer.size()));
+  float lvl = level;
+  float dc = dcLevel;
+  float y = output;
+  float const hp = highPass;
+  float const* in = buffer.data();
+  for (size_t k = 0; k < n; ++k) {
+    lvl += in[k];
+    y = lvl - dc;
+    dc += hp * y;
+    if (samples) store(samples + k, y);
+  }
+  if (samples) {
+    for (size_t k = n; k < numSamples; ++k) {
+      store(samples + k, y);
+    }
+  }
+  level = lvl;
+  dcLevel = dc;
+  output = y;
+
+  // Shift the buffer.
+  size_t const numLeft = numUsed > n ? numUsed - n : 0;
+  memmove(buffer.data(), buffer.data() + n, numLeft * sizeof(float));
+  fill(buffer.begin() + numLeft, buffer.begin() + max(numUsed, numLeft), 0.0f);
+  numUsed = numLeft;
+  numAvailable -= n;
+  origin -= n;
+  return n;
+}
+
+/// Drop the `numSamples` oldest samples, as if they were read.
+void TIASoundSynthesizer::drop(size_t numSamples) {
+  numAvailable = max(numAvailable, min(numSamples, buffer.size()));
+  size_t n = readSamples<float>(nullptr, numSamples);
+  if (n < numSamples) {
+    // The rest of the samples have no steps: the output decays to zero.
+    double m = static_cast<double>(numSamples - n);
+    output *= static_cast<float>(pow(1 - highPass, m));
+    dcLevel = level - output;
+    origin -= m;
+  }
+}
@@ -0,0 +1,93 @@
+// TIASoundSynthesizer.hpp
+// Atari 2600 TIA sound emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef TIASoundSynthesizer_hpp
+#define TIASoundSynthesizer_hpp
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jigo {
+
+class TIASound;
+
+// -----------------------------------------------------------------
+// MARK: - TIA sound synthesizer
+// -----------------------------------------------------------------
+
+/// Convert the sound events of the two TIA channels into a mono audio
+/// stream at the host sample rate, using band-limited steps (BLEP). Each
+/// change of the output level adds a windowed-sinc step, precomputed for
+/// `numPhases` sub-sample offsets, to a buffer of differences, which is
+/// then integrated and high-passed to remove DC when the samples are read.
+///
+/// The synthesizer is the consumer of the channel queues, so it may run
+/// on the audio thread while the emulation runs on another. `pull()`
+/// consumes the events simulated so far and makes the corresponding
+/// samples available to `read()`. If they are not read, the oldest samples
+/// are dropped to bound the latency. Offline consumers can avoid this by
+/// pulling up to `getMaxPullTime()` at a time and reading the samples in
+/// between.
+class TIASoundSynthesizer {
+public:
+  TIASoundSynthesizer(double sampleRate = 44100, double clockRate = 3.579545e6);
+
+  // Configure.
+  double getSampleRate() const { return sampleRate; }
+  void setClockRate(double x);
+  double getClockRate() const { return clockRate; }
+
+  // Operate.
+  size_t pull(TIASound const& channel0, TIASound const& channel1,
+              long long maxTime = LLONG_MAX);
+  long long getMaxPullTime(TIASound const& channel0, TIASound const& channel1) const;
+  size_t getNumAvailable() const { return numAvailable; }
+  size_t read(float* samples, size_t numSamples);
+  size_t read(std::int16_t* samples, size_t numSamples);
+  void clear();
+
+protected:
+  static constexpr int numPhases = 32;
+  static constexpr int kernelWidth = 16;
+  struct Tables {
+    Tables();
+    float steps[numPhases + 1][kernelWidth];
+  };
+  static Tables const tables;
+
+  double getPosition(long long time) const {
+    return origin + (time - originTime) * samplesPerCycle;
+  }
+  void addStep(double position, float delta);
+  void drop(size_t numSamples);
+  template <class T> size_t readSamples(T* samples, size_t numSamples);
+
+  double sampleRate;
+  double clockRate;
+  double samplesPerCycle;
+  float highPass;
+  bool started;
+
+  // Map from stream time to sample position, relative to the first sample
+  // in the buffer.
+  long long originTime;
+  double origin;
+
+  // Buffer of differences and integrator.
+  std::vector<float> buffer;
+  size_t numAvailable;
+  size_t numUsed;
+  float level;
+  float dcLevel;
+  float output;
+};
+
+} // namespace jigo
+
+#endif /* TIASoundSynthesizer_hpp */
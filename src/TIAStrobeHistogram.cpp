@@ -0,0 +1,78 @@
+// TIAStrobeHistogram.cpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#include "TIAStrobeHistogram.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace jigo;
+
+// -------------------------------------------------------------------
+// MARK: - Lifecycle
+// -------------------------------------------------------------------
+
+TIAStrobeHistogram::TIAStrobeHistogram() {
+  for (auto& frame : frames) {
+    frame.resize(width * height);
+  }
+  clear();
+}
+
+/// Empty both frames and reset the frame counter. This must not be called
+/// while the histogram is read from another thread.
+void TIAStrobeHistogram::clear() {
+  for (int k = 0; k < 2; ++k) {
+    fill(frames[k].begin(), frames[k].end(), uint8_t(none));
+    counts[k].fill(0);
+  }
+  current.store(0, std::memory_order_release);
+  numFrames.store(0, std::memory_order_release);
+}
+
+// -------------------------------------------------------------------
+// MARK: - Record
+// -------------------------------------------------------------------
+
+/// Complete the current frame, which becomes the last one, and start a new
+/// one in the other buffer. Called by the producer only.
+void TIAStrobeHistogram::endFrame() {
+  // Publish the completed frame, then announce that the buffer of the
+  // previous one is about to be reused (see `copyLastFrame()`).
+  int k = current.load(std::memory_order_relaxed) ^ 1;
+  current.store(k, std::memory_order_release);
+  numFrames.store(numFrames.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  atomic_thread_fence(std::memory_order_release);
+  fill(frames[k].begin(), frames[k].end(), uint8_t(none));
+  counts[k].fill(0);
+}
+
+// -------------------------------------------------------------------
+// MARK: - Inspect
+// -------------------------------------------------------------------
+
+/// Copy the last complete frame into `frame`, an array of `width * height`
+/// bytes, and its counts into `counts`, an array of `numRegisters` values.
+/// Either can be null. Returns the number of the frame, counting from zero,
+/// or -1 if none is complete yet. This can be called from any thread: if a
+/// frame ends during the copy, the copy is repeated.
+int64_t TIAStrobeHistogram::copyLastFrame(uint8_t* frame, uint32_t* counts) const {
+  while (true) {
+    auto n = numFrames.load(std::memory_order_acquire);
+    int k = getCurrent() ^ 1;
+    if (frame) {
+      memcpy(frame, frames[k].data(), width * height);
+    }
+    if (counts) {
+      memcpy(counts, this->counts[k].data(), numRegisters * sizeof(uint32_t));
+    }
+    atomic_thread_fence(std::memory_order_acquire);
+    if (numFrames.load(std::memory_order_relaxed) == n) return n - 1;
+  }
+}
@@ -0,0 +1,86 @@
+// TIAStrobeHistogram.hpp
+// Atari2600 emulator
+
+// Copyright (c) 2018 The Jigo2600 Team. All rights reserved.
+// This file is part of Jigo2600 and is made available under
+// the terms of the BSD license (see the COPYING file).
+
+#ifndef TIAStrobeHistogram_hpp
+#define TIAStrobeHistogram_hpp
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace jigo {
+
+// -----------------------------------------------------------------
+// MARK: - TIA strobe histogram
+// -----------------------------------------------------------------
+
+/// Map the register strobes of each frame to the beam position at which
+/// they land (see `TIA::setStrobeHistogram()`), in order to correlate the
+/// writes of a kernel with the picture. A frame is a `[height, width]` array
+/// of bytes indexed by `beamY` and `beamX` holding the register strobed at
+/// that color clock, or `none`; at most one strobe lands on each color
+/// clock, as the CPU writes at most every third one. The number of strobes
+/// of each register is also counted.
+///
+/// The frames are double-buffered: the one in progress is filled while the
+/// last complete one is left untouched until the end of the next frame, so
+/// that it can be read in between without locking. The pointers returned by
+/// `getLastFrame()` and `getLastCounts()` are only valid until then, when
+/// the buffer is cleared and reused for the frame in progress; consumers on
+/// other threads should use `copyLastFrame()`, which never returns a torn
+/// frame.
+class TIAStrobeHistogram {
+public:
+  static constexpr int width = 228;  /// Color clocks per line.
+  static constexpr int height = 312; /// Lines per frame (PAL).
+  static constexpr int numRegisters = 64;
+  static constexpr std::uint8_t none = 0xff;
+
+  // Lifecycle.
+  TIAStrobeHistogram();
+  void clear();
+
+  // Record.
+  void record(int reg, int beamX, int beamY);
+  void endFrame();
+
+  // Inspect.
+  std::uint8_t const* getCurrentFrame() const { return frames[getCurrent()].data(); }
+  std::uint8_t const* getLastFrame() const { return frames[getCurrent() ^ 1].data(); }
+  std::uint32_t const* getCurrentCounts() const { return counts[getCurrent()].data(); }
+  std::uint32_t const* getLastCounts() const { return counts[getCurrent() ^ 1].data(); }
+  std::int64_t getNumFrames() const { return numFrames.load(std::memory_order_acquire); }
+  std::int64_t copyLastFrame(std::uint8_t* frame, std::uint32_t* counts) const;
+
+protected:
+  int getCurrent() const { return current.load(std::memory_order_acquire); }
+
+  std::array<std::vector<std::uint8_t>, 2> frames;
+  std::array<std::array<std::uint32_t, numRegisters>, 2> counts;
+  std::atomic<int> current;
+  std::atomic<std::int64_t> numFrames;
+};
+
+// -----------------------------------------------------------------
+// MARK: - Inline members
+// -----------------------------------------------------------------
+
+/// Record the strobe of the register `reg` at the beam position (`beamX`,
+/// `beamY`). The strobes past the last line are only counted. Called by the
+/// producer only.
+inline void TIAStrobeHistogram::record(int reg, int beamX, int beamY) {
+  int k = current.load(std::memory_order_relaxed);
+  ++counts[k][reg & (numRegisters - 1)];
+  if (0 <= beamY && beamY < height && 0 <= beamX && beamX < width) {
+    frames[k][beamY * width + beamX] = static_cast<std::uint8_t>(reg);
+  }
+}
+
+} // namespace jigo
+
+#endif /* TIAStrobeHistogram_hpp */